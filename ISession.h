@@ -1,17 +1,41 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <opencv2/opencv.hpp>
 
 #include "YoloDefine.h"
 #include "Model.h"
 
+
+/// @brief 会话的就绪状态
+enum class SessionState
+{
+    Uninitialized,  // 尚未初始化
+    Loading,        // 正在创建会话、解析模型、预热
+    Ready,          // 可以推理
+    Failed          // 初始化失败
+};
+
+/// @brief 预热结果
+struct WarmUpReport
+{
+    double coldLatencyMs = 0;   // 第一次推理(冷启动)耗时
+    double warmLatencyMs = 0;   // 延迟稳定后的推理耗时
+    int iterations = 0;         // 实际预热次数
+    bool stable = false;        // 是否在最大次数内达到稳定
+};
+
 class ISession
 {
 public:
     ISession() = default;
-    ~ISession() = default;
+    virtual ~ISession() { JoinInitialization(); };
 
 
 public:
@@ -20,11 +44,62 @@ public:
     /// @return 返回是否初始化成功
     virtual bool Initialize(const std::string& modelPath) = 0;
 
+    /// @brief 在后台线程中执行 Initialize, 立即返回, 可通过 GetState / WaitReady 查询结果;
+    /// 上次初始化失败时可以再次调用重试
+    /// @param modelPath 模型路径
+    /// @return 已经初始化成功或正在初始化时返回false
+    virtual bool InitializeAsync(const std::string& modelPath)
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        if(state_ != SessionState::Uninitialized && state_ != SessionState::Failed)
+            return false;
+
+        // 进入 Failed 是上一个后台线程的最后一步, 此时 join 不会阻塞在 stateMutex_ 上
+        if(initThread_.joinable())
+            initThread_.join();
+
+        state_ = SessionState::Loading;
+        initThread_ = std::thread([this, modelPath]() { Initialize(modelPath); });
+        return true;
+    }
+
+    /// @brief 获取当前就绪状态
+    SessionState GetState() const { return state_.load(); };
+
+    /// @brief 等待初始化完成; 超时不会中止后台线程, 析构时仍会等待其结束
+    /// @param timeout 最长等待时间
+    /// @return 在超时前进入 Ready 状态返回true, 失败或超时返回false
+    bool WaitReady(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        stateChanged_.wait_for(lock, timeout, [this]() {
+            return state_ == SessionState::Ready || state_ == SessionState::Failed;
+        });
+        return state_ == SessionState::Ready;
+    }
+
+    /// @brief 获取预热结果
+    virtual WarmUpReport GetWarmUpReport() { return warmUpReport_; };
+
     /// @brief 模型推理入口
     /// @param image 输入的图像
     /// @return 返回推理完成的结果
     virtual std::vector<ResultNode> Detect(const cv::Mat& image) = 0;
 
+    /// @brief 一次 DetectBatch 能真正合并推理的最大帧数, 默认不支持批量推理
+    virtual size_t MaxBatch() { return 1; };
+
+    /// @brief 批量推理入口, 默认逐张调用 Detect
+    /// @param images 输入的图像
+    /// @return 返回与 images 一一对应的结果
+    virtual std::vector<std::vector<ResultNode>> DetectBatch(const std::vector<cv::Mat>& images)
+    {
+        std::vector<std::vector<ResultNode>> results;
+        for(const auto& image : images)
+            results.push_back(Detect(image));
+        return results;
+    }
+
     /// @brief 获取模型参数
     /// @return 
     virtual Model* GetModel()  { return model_; };
@@ -40,9 +115,33 @@ public:
 protected:
     virtual bool WarmUpModel() = 0;
 
+    void SetState(SessionState state)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex_);
+            state_ = state;
+        }
+        stateChanged_.notify_all();
+    }
+
+    /// @brief 等待后台初始化线程结束, 派生类析构时需要先调用, 避免后台线程访问已析构的成员
+    void JoinInitialization()
+    {
+        if(initThread_.joinable())
+            initThread_.join();
+    }
+
 protected:
-    Model *model_;
+    Model *model_ = nullptr;
 
     float confidenceThreshold_ = 0.5;
     float iouThreshold_ = 0.45;
+
+    WarmUpReport warmUpReport_;
+
+private:
+    std::atomic<SessionState> state_{SessionState::Uninitialized};
+    std::mutex stateMutex_;
+    std::condition_variable stateChanged_;
+    std::thread initThread_;
 };
\ No newline at end of file
@@ -10,8 +10,12 @@ struct Model
 
     std::vector<std::string> labels;
 
+    /// 动态维度(-1)已被替换为实际使用的大小, 见 ModelParser
     std::vector<std::vector<int64_t>> inputShapes;
 
+    /// 输入的 batch 维度在模型中是否为动态
+    bool dynamicBatch = false;
+
     std::vector<std::vector<int64_t>> outputShapes;
 
     std::vector<std::string> inputNames;
@@ -19,6 +23,21 @@ struct Model
 
     std::vector<std::string> outputNames;
     std::vector<const char*> outputNamesPtr;
+
+    /// 已解码输出 [1, N, no] 的下标
+    size_t decodedOutput = 0;
+
+    /// 4/5维检测头输出的下标, 按输出顺序(P3/P4/P5)排列
+    std::vector<size_t> headOutputs;
+
+    /// 模型没有已解码的输出, 只有未解码的检测头, 需要在后处理中完成 sigmoid 和 anchor 解码
+    bool rawHeads = false;
+
+    /// 每个检测头的步长, 为空时按 输入高度 / 特征图高度 计算
+    std::vector<float> strides;
+
+    /// 每个检测头的 anchor, 以像素为单位, w,h 交替排列
+    std::vector<std::vector<float>> anchors;
 };
 
 
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/// @brief 会话内算子的执行方式
+enum class SessionExecutionMode
+{
+    Sequential, // 顺序执行, 单模型推理时一般更快
+    Parallel    // 图中无依赖的分支并行执行, 依赖 inter-op 线程池
+};
+
+
+/// @brief CPU arena 申请新内存块的方式
+enum class ArenaExtendStrategy
+{
+    NextPowerOfTwo,     // 按2的幂增长, 分配次数少但可能多占内存
+    SameAsRequested     // 只申请所需大小, 峰值更低
+};
+
+
+/// @brief 推理会话的运行配置, 多个会话共享一台机器时用于控制线程和CPU资源
+struct SessionConfig
+{
+    /// intra-op 线程数, 0 表示由 onnxruntime 决定(默认等于物理核数)
+    int intraOpNumThreads = 0;
+
+    /// inter-op 线程数, 只在 Parallel 模式下有意义, 0 表示由 onnxruntime 决定
+    int interOpNumThreads = 0;
+
+    SessionExecutionMode executionMode = SessionExecutionMode::Sequential;
+
+    /// 线程池空闲时是否自旋等待, 关闭后延迟略升但不再空耗CPU
+    bool allowSpinning = true;
+
+    /// 使用进程级共享线程池并关闭会话私有线程池。
+    /// 共享线程池在第一个会话创建 Ort::Env 时按该会话的配置建立, 之后的会话共用
+    bool useGlobalThreadPool = false;
+
+    /// intra-op 线程绑定的逻辑核编号, 为空时不绑定。
+    /// 池线程由 onnxruntime 绑定, 调用 Detect 的线程只在推理期间绑定(单线程时绑定到全部核, 否则绑定到第一个核);
+    /// 使用全局线程池时以创建 Env 的会话的配置为准
+    std::vector<int> cpuAffinity;
+
+    /// 绑定到指定 NUMA 节点上的全部逻辑核, -1 表示不绑定; cpuAffinity 非空时以 cpuAffinity 为准
+    int numaNode = -1;
+
+    /// CUDA 可用时是否使用GPU
+    bool useGpu = true;
+
+    /// 初始化时是否预热模型
+    bool warmup = true;
+
+    /// 预热的最少/最多推理次数
+    int warmupMinIterations = 3;
+    int warmupMaxIterations = 20;
+
+    /// 相邻两次预热延迟的相对变化小于该值时视为已稳定
+    double warmupStableRatio = 0.05;
+
+    /// 是否使用 CPU 内存池(arena), 关闭后每次按需申请释放, 内存占用更低但分配开销更大
+    bool enableCpuMemArena = true;
+
+    /// 是否启用内存复用规划(memory pattern), 输入尺寸固定时可减少分配; 关闭可降低峰值
+    bool enableMemPattern = true;
+
+    /// 所有会话共用一个注册在 Ort::Env 上的 CPU arena, 以下两项只对共享 arena 生效。
+    /// 与全局线程池一样, 共享 arena 按第一个开启该选项的会话的配置创建
+    bool useSharedCpuArena = false;
+    ArenaExtendStrategy arenaExtendStrategy = ArenaExtendStrategy::NextPowerOfTwo;
+    size_t arenaMaxBytes = 0;   // 0 表示不限制
+
+    /// 每次推理结束后收缩 arena, 把未使用的内存块归还系统
+    bool shrinkArenaAfterRun = false;
+
+    /// 记录流水线各阶段耗时, 通过 Yolov5Session::WriteTrace 输出 Chrome trace
+    bool enableTracing = false;
+
+    /// 每 traceSampleEvery 帧记录一帧
+    int traceSampleEvery = 1;
+
+    /// 同时开启 onnxruntime 自带的 profiling 并合并到同一条时间线(对整个会话生效, 不受采样控制)
+    bool traceOrtProfiling = false;
+
+    /// onnxruntime profiling 文件的前缀
+    std::string ortProfilePrefix = "yolov5_ort_profile";
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#include "runtime/LatencyWindow.h"
+
+
+/// @brief 计算从 start 到现在经过的毫秒数
+inline double ElapsedMs(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
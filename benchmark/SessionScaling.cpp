@@ -0,0 +1,112 @@
+#include "yolov5/Yolov5Session.h"
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "BenchUtils.h"
+
+// 在同一台机器上并发运行 1~N 个会话, 比较不同线程池配置下的吞吐和延迟
+// 用法: SessionScaling <modelPath> <imagePath> [maxSessions] [framesPerSession] [default|split|pinned|global]
+//   default: 每个会话使用 onnxruntime 默认线程数(原有行为, 会话越多越容易超额订阅)
+//   split  : 按会话数平分逻辑核(hardware_concurrency), 关闭自旋
+//   pinned : 同 split, 并把第 idx 个会话绑定到互不重叠的一段逻辑核上
+//   global : 所有会话共享一个全局线程池, 关闭会话私有线程池
+
+static SessionConfig MakeConfig(const std::string& mode, int sessions, int idx, int hwThreads)
+{
+    SessionConfig config;
+    config.useGpu = false;
+
+    if(mode == "split" || mode == "pinned")
+    {
+        int threads = std::max(1, hwThreads / sessions);
+        config.intraOpNumThreads = threads;
+        config.allowSpinning = false;
+        if(mode == "pinned")
+        {
+            // 会话数多于逻辑核时只能回绕, 此时多个会话共用同一个核
+            for(int cpu = 0; cpu < threads; ++cpu)
+                config.cpuAffinity.push_back((idx * threads + cpu) % hwThreads);
+        }
+    }else if(mode == "global")
+    {
+        config.useGlobalThreadPool = true;
+        config.intraOpNumThreads = hwThreads;
+        config.allowSpinning = false;
+    }
+    return config;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::cout << "Usage: " << argv[0]
+            << " <modelPath> <imagePath> [maxSessions] [framesPerSession] [default|split|pinned|global]" << "\n";
+        return 0;
+    }
+    std::string modelPath = argv[1];
+    cv::Mat image = cv::imread(argv[2]);
+    int maxSessions = argc > 3 ? std::stoi(argv[3]) : 4;
+    int frames = argc > 4 ? std::stoi(argv[4]) : 50;
+    std::string mode = argc > 5 ? argv[5] : "default";
+    int hwThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    if(image.empty())
+    {
+        std::cerr << "failed to read image: " << argv[2] << "\n";
+        return 1;
+    }
+
+    std::cout << "mode:" << mode << " hardware threads:" << hwThreads << " frames/session:" << frames << "\n";
+    std::cout << std::setw(10) << "sessions" << std::setw(12) << "fps"
+              << std::setw(12) << "p50(ms)" << std::setw(12) << "p95(ms)" << std::setw(12) << "p99(ms)" << "\n";
+
+    for(int sessionCnt = 1; sessionCnt <= maxSessions; ++sessionCnt)
+    {
+        std::vector<std::unique_ptr<Yolov5Session>> sessions;
+        for(int idx = 0; idx < sessionCnt; ++idx)
+        {
+            sessions.emplace_back(new Yolov5Session(MakeConfig(mode, sessionCnt, idx, hwThreads)));
+            if(!sessions.back()->Initialize(modelPath))
+            {
+                std::cerr << "failed to initialize session " << idx << "\n";
+                return 1;
+            }
+        }
+
+        std::vector<std::vector<double>> latencies(sessionCnt);
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for(int idx = 0; idx < sessionCnt; ++idx)
+        {
+            workers.emplace_back([&, idx]() {
+                for(int frame = 0; frame < frames; ++frame)
+                {
+                    auto frameStart = std::chrono::steady_clock::now();
+                    sessions[idx]->Detect(image);
+                    latencies[idx].push_back(ElapsedMs(frameStart));
+                }
+            });
+        }
+        for(auto& worker : workers)
+            worker.join();
+        double totalMs = ElapsedMs(start);
+
+        std::vector<double> all;
+        for(const auto& samples : latencies)
+            all.insert(all.end(), samples.begin(), samples.end());
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(10) << sessionCnt
+                  << std::setw(12) << all.size() * 1000.0 / totalMs
+                  << std::setw(12) << Percentile(all, 50)
+                  << std::setw(12) << Percentile(all, 95)
+                  << std::setw(12) << Percentile(all, 99) << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include "yolov5/Yolov5Session.h"
+
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "BenchUtils.h"
+#include "runtime/MemoryStats.h"
+
+// 长时间运行 Detect, 定期采样 RSS、malloc 统计和延迟分位数, 检查内存增长和延迟漂移
+// 用法: Soak <modelPath> <imagePath> <--duration-sec N | --frames N> [--sessions N] [--interval-sec N]
+//            [--warmup-intervals N] [--max-rss-growth-mb N] [--max-heap-growth-mb N] [--max-p95-drift-pct N]
+// --duration-sec 和 --frames 至少指定一个, 同时指定时先达到者结束
+// 基线取预热结束后的第一次采样, 结束时与最后几次采样的平均值比较, 超出阈值时返回1
+
+struct SoakOptions
+{
+    double durationSec = 0;         // 0 表示不限时长
+    uint64_t maxFrames = 0;         // 0 表示不限帧数
+    int sessions = 1;
+    double intervalSec = 10;
+    int warmupIntervals = 2;        // 预热阶段的采样不参与基线
+    double maxRssGrowthMb = 50;
+    double maxHeapGrowthMb = 20;
+    double maxP95DriftPct = 20;
+};
+
+struct SoakSample
+{
+    double elapsedSec;
+    uint64_t frames;
+    size_t rssBytes;
+    HeapStats heap;
+    double p50Ms, p95Ms, p99Ms;
+};
+
+static bool ParseOptions(int argc, char* argv[], SoakOptions& options)
+{
+    for(int idx = 3; idx + 1 < argc; idx += 2)
+    {
+        std::string key = argv[idx];
+        double value = 0;
+        try
+        {
+            size_t parsed = 0;
+            value = std::stod(argv[idx + 1], &parsed);
+            if(argv[idx + 1][parsed] != '\0')
+                throw std::invalid_argument(argv[idx + 1]);
+        }catch(const std::exception&)
+        {
+            std::cerr << "invalid value for " << key << ": " << argv[idx + 1] << "\n";
+            return false;
+        }
+        if(key == "--duration-sec")
+            options.durationSec = value;
+        else if(key == "--frames")
+            options.maxFrames = static_cast<uint64_t>(value);
+        else if(key == "--sessions")
+            options.sessions = std::max(1, static_cast<int>(value));
+        else if(key == "--interval-sec")
+            options.intervalSec = value;
+        else if(key == "--warmup-intervals")
+            options.warmupIntervals = static_cast<int>(value);
+        else if(key == "--max-rss-growth-mb")
+            options.maxRssGrowthMb = value;
+        else if(key == "--max-heap-growth-mb")
+            options.maxHeapGrowthMb = value;
+        else if(key == "--max-p95-drift-pct")
+            options.maxP95DriftPct = value;
+        else
+        {
+            std::cerr << "unknown option: " << key << "\n";
+            return false;
+        }
+    }
+    if((argc - 3) % 2 != 0)
+        return false;
+    if(options.durationSec <= 0 && options.maxFrames == 0)
+    {
+        std::cerr << "either --duration-sec or --frames is required\n";
+        return false;
+    }
+    return true;
+}
+
+/// @brief 取最后 count 个采样的平均值
+template<class Getter>
+static double TailMean(const std::vector<SoakSample>& samples, size_t count, Getter getter)
+{
+    count = std::min(count, samples.size());
+    double sum = 0;
+    for(size_t idx = samples.size() - count; idx < samples.size(); ++idx)
+        sum += getter(samples[idx]);
+    return count ? sum / count : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    SoakOptions options;
+    if(argc < 3 || !ParseOptions(argc, argv, options))
+    {
+        std::cout << "Usage: " << argv[0] << " <modelPath> <imagePath> <--duration-sec N | --frames N> [--sessions N]"
+            << " [--interval-sec N] [--warmup-intervals N] [--max-rss-growth-mb N] [--max-heap-growth-mb N]"
+            << " [--max-p95-drift-pct N]" << "\n";
+        return 0;
+    }
+    std::string modelPath = argv[1];
+    cv::Mat image = cv::imread(argv[2]);
+    if(image.empty())
+    {
+        std::cerr << "failed to read image: " << argv[2] << "\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Yolov5Session>> sessions;
+    for(int idx = 0; idx < options.sessions; ++idx)
+    {
+        SessionConfig config;
+        config.intraOpNumThreads = std::max(1u, std::thread::hardware_concurrency() / options.sessions);
+        sessions.emplace_back(new Yolov5Session(config));
+        if(!sessions.back()->Initialize(modelPath))
+        {
+            std::cerr << "failed to initialize session " << idx << "\n";
+            return 1;
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> frames{0};
+    std::mutex latencyMutex;
+    std::vector<double> intervalLatencies;  // 当前采样周期内的延迟
+
+    std::vector<std::thread> workers;
+    for(auto& session : sessions)
+    {
+        workers.emplace_back([&, session = session.get()]() {
+            while(!stop.load())
+            {
+                auto start = std::chrono::steady_clock::now();
+                session->Detect(image);
+                double ms = ElapsedMs(start);
+                {
+                    std::lock_guard<std::mutex> lock(latencyMutex);
+                    intervalLatencies.push_back(ms);
+                }
+                uint64_t done = ++frames;
+                if(options.maxFrames > 0 && done >= options.maxFrames)
+                    stop.store(true);
+            }
+        });
+    }
+
+    std::cout << std::setw(10) << "time(s)" << std::setw(12) << "frames" << std::setw(12) << "rss(MB)"
+              << std::setw(12) << "heap(MB)" << std::setw(12) << "free(MB)"
+              << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << "\n";
+
+    const double mb = 1024.0 * 1024.0;
+    std::vector<SoakSample> samples;
+    auto begin = std::chrono::steady_clock::now();
+    while(!stop.load())
+    {
+        // 以较小的粒度睡眠, 以便按帧数结束时及时退出
+        auto intervalStart = std::chrono::steady_clock::now();
+        while(!stop.load() && ElapsedMs(intervalStart) < options.intervalSec * 1000.0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if(options.durationSec > 0 && ElapsedMs(begin) >= options.durationSec * 1000.0)
+            stop.store(true);
+
+        std::vector<double> latencies;
+        {
+            std::lock_guard<std::mutex> lock(latencyMutex);
+            latencies.swap(intervalLatencies);
+        }
+
+        SoakSample sample;
+        sample.elapsedSec = ElapsedMs(begin) / 1000.0;
+        sample.frames = frames.load();
+        sample.rssBytes = CurrentRssBytes();
+        sample.heap = CurrentHeapStats();
+        sample.p50Ms = Percentile(latencies, 50);
+        sample.p95Ms = Percentile(latencies, 95);
+        sample.p99Ms = Percentile(latencies, 99);
+        samples.push_back(sample);
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(10) << sample.elapsedSec << std::setw(12) << sample.frames
+                  << std::setw(12) << sample.rssBytes / mb << std::setw(12) << sample.heap.inUseBytes / mb
+                  << std::setw(12) << sample.heap.freeBytes / mb
+                  << std::setprecision(2)
+                  << std::setw(10) << sample.p50Ms << std::setw(10) << sample.p95Ms << std::setw(10) << sample.p99Ms
+                  << std::endl;
+    }
+
+    for(auto& worker : workers)
+        worker.join();
+
+    const size_t tail = 3;
+    if(samples.size() < static_cast<size_t>(options.warmupIntervals) + tail + 1)
+    {
+        std::cerr << "not enough samples to judge, increase --duration-sec/--frames or decrease --interval-sec\n";
+        return 1;
+    }
+
+    const SoakSample& baseline = samples[options.warmupIntervals];
+    double rssGrowthMb = (TailMean(samples, tail, [](const SoakSample& s) { return static_cast<double>(s.rssBytes); })
+        - baseline.rssBytes) / mb;
+    double heapGrowthMb = (TailMean(samples, tail, [](const SoakSample& s) { return static_cast<double>(s.heap.inUseBytes); })
+        - baseline.heap.inUseBytes) / mb;
+    double tailP95 = TailMean(samples, tail, [](const SoakSample& s) { return s.p95Ms; });
+    double p95DriftPct = baseline.p95Ms > 0 ? (tailP95 - baseline.p95Ms) / baseline.p95Ms * 100.0 : 0;
+
+    std::cout << std::setprecision(2)
+              << "rss growth: " << rssGrowthMb << " MB (limit " << options.maxRssGrowthMb << ")\n"
+              << "heap growth: " << heapGrowthMb << " MB (limit " << options.maxHeapGrowthMb << ")\n"
+              << "p95 drift: " << p95DriftPct << " % (limit " << options.maxP95DriftPct << ")\n";
+
+    bool passed = rssGrowthMb <= options.maxRssGrowthMb && heapGrowthMb <= options.maxHeapGrowthMb
+        && p95DriftPct <= options.maxP95DriftPct;
+    std::cout << (passed ? "PASS" : "FAIL") << "\n";
+    return passed ? 0 : 1;
+}
@@ -5,25 +5,49 @@
 #include <iostream>
 #include <filesystem>
 #include <chrono>
+#include <cstdlib>
 #include <string>
 
 #include "Mics.h"
+#include "runtime/Tracer.h"
 
 int main(int argc, char* argv[])
 {
     const std::string imageExt = ".jpg"; // 图像的扩展名
     bool renderAndSave = true; // 是否绘制外框
-    if(argc != 3)
+    if(argc != 3 && argc != 4)
     {
-        std::cout << "Usage: " << argv[0] << " <modelPath> <inputImagePath>" << "\n";
+        std::cout << "Usage: " << argv[0] << " <modelPath> <inputImagePath> [traceOutputPath]" << "\n";
         return 0;
     }   
     std::string modelPath = argv[1];
     std::string dataSrc = argv[2];
-    ISession *session = new Yolov5Session();
-    bool isValid = session->Initialize(modelPath);
-    auto* model = session->GetModel();
+    std::string tracePath = argc == 4 ? argv[3] : ""; // 指定时输出 Chrome trace 格式的耗时记录
+
+    SessionConfig config;
+    config.enableTracing = !tracePath.empty();
+    config.traceOrtProfiling = config.enableTracing;
+    const auto initTimeout = std::chrono::seconds(120); // 等待模型加载的最长时间
+    Yolov5Session *session = new Yolov5Session(config);
+    session->InitializeAsync(modelPath);
+    bool isValid = session->WaitReady(initTimeout);
     std::cout << "initialize status:" << (isValid ? "true":"false") << "\n";
+    if(!isValid)
+    {
+        // 超时时后台线程仍在加载, delete 会一直等到加载结束; 直接退出进程, 使超时真正限制退出时间
+        if(session->GetState() == SessionState::Loading)
+        {
+            std::cerr << "model loading timed out" << std::endl;
+            std::quick_exit(1);
+        }
+        delete session;
+        return 1;
+    }
+
+    auto* model = session->GetModel();
+    auto warmUp = session->GetWarmUpReport();
+    std::cout << "warm up: cold " << warmUp.coldLatencyMs << " ms, warm " << warmUp.warmLatencyMs 
+        << " ms, iterations " << warmUp.iterations << (warmUp.stable ? "" : " (not stable)") << "\n";
 
     std::filesystem::path data = dataSrc;
     
@@ -41,7 +65,10 @@ int main(int argc, char* argv[])
     {
         filenames.push_back(data.string());
     }else 
+    {
+        delete session;
         return 0;
+    }
 
 
     for(const auto& imagePath : filenames)
@@ -64,7 +91,12 @@ int main(int argc, char* argv[])
 
         if(renderAndSave)
         {
-            cv::Mat out = RenderBoundingBoxes(image, result, model->labels);
+            cv::Mat out;
+            {
+                TraceScope scope("Render");
+                out = RenderBoundingBoxes(image, result, model->labels);
+            }
+            TraceScope scope("Write");
             std::filesystem::path oriPath = imagePath;
             std::string dirPath = std::filesystem::current_path().string() + "/result/";
             if(!std::filesystem::exists(dirPath))
@@ -76,6 +108,9 @@ int main(int argc, char* argv[])
         }
     }
     
+    if(!tracePath.empty() && session->WriteTrace(tracePath))
+        std::cout << "trace saved in:" << tracePath << "\n";
 
+    delete session;
     return 0;
 }
@@ -0,0 +1,217 @@
+#include "AdaptiveSession.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "yolov5/Yolov5Session.h"
+
+
+AdaptiveSession::AdaptiveSession(const std::vector<ModelVariant>& variants, const AdaptivePolicy& policy)
+    :variants_(variants), policy_(policy), window_(policy.windowSize)
+{
+
+}
+
+AdaptiveSession::~AdaptiveSession()
+{
+    JoinInitialization();
+}
+
+bool AdaptiveSession::Initialize(const std::string& modelPath)
+{
+    SetState(SessionState::Loading);
+    if(variants_.empty())
+        variants_.push_back(ModelVariant{"default", modelPath, SessionConfig()});
+
+    bool valid = true;
+    sessions_.clear();
+    for(const auto& variant : variants_)
+    {
+        sessions_.emplace_back(new Yolov5Session(variant.config));
+        sessions_.back()->SetConfidence(confidenceThreshold_);
+        sessions_.back()->SetIOU(iouThreshold_);
+        if(!sessions_.back()->Initialize(variant.modelPath))
+        {
+            std::cerr << "failed to initialize variant " << variant.name << ": " << variant.modelPath << "\n";
+            valid = false;
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        framesPerVariant_.assign(variants_.size(), 0);
+        lastP95_.assign(variants_.size(), 0);
+        observedRatio_.assign(variants_.size(), 0);
+        previous_ = 0;
+        ratioPending_ = false;
+        warmLatencyMs_.clear();
+        for(auto& session : sessions_)
+            warmLatencyMs_.push_back(session->GetWarmUpReport().warmLatencyMs);
+        warmLatencyMs_.resize(variants_.size(), 0);
+        window_.Clear();
+        framesSinceSwitch_ = 0;
+        probing_ = false;
+        upgradeBackoffFrames_ = policy_.minFramesBetweenSwitches;
+    }
+    active_.store(0);
+
+    SetState(valid ? SessionState::Ready : SessionState::Failed);
+    return valid;
+}
+
+std::vector<ResultNode> AdaptiveSession::Detect(const cv::Mat& image)
+{
+    return DetectAdaptive(image).detections;
+}
+
+AdaptiveResult AdaptiveSession::DetectAdaptive(const cv::Mat& image)
+{
+    AdaptiveResult result;
+    if(GetState() != SessionState::Ready)
+        return result;
+
+    result.variant = active_.load();
+    result.variantName = variants_[result.variant].name;
+
+    auto start = std::chrono::steady_clock::now();
+    result.detections = sessions_[result.variant]->Detect(image);
+    result.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    Record(result.variant, result.latencyMs);
+    return result;
+}
+
+Model* AdaptiveSession::GetModel()
+{
+    if(sessions_.empty())
+        return nullptr;
+    return sessions_[active_.load()]->GetModel();
+}
+
+void AdaptiveSession::SetConfidence(float conf)
+{
+    confidenceThreshold_ = conf;
+    for(auto& session : sessions_)
+        session->SetConfidence(conf);
+}
+
+void AdaptiveSession::SetIOU(float iou)
+{
+    iouThreshold_ = iou;
+    for(auto& session : sessions_)
+        session->SetIOU(iou);
+}
+
+AdaptiveMetrics AdaptiveSession::GetMetrics()
+{
+    AdaptiveMetrics metrics;
+    std::lock_guard<std::mutex> lock(mutex_);
+    metrics.activeVariant = active_.load();
+    if(metrics.activeVariant < variants_.size())
+        metrics.activeVariantName = variants_[metrics.activeVariant].name;
+    metrics.p95Ms = window_.Percentile(95);
+    metrics.lastP95PerVariant = lastP95_;
+    if(metrics.activeVariant < metrics.lastP95PerVariant.size())
+        metrics.lastP95PerVariant[metrics.activeVariant] = metrics.p95Ms;
+    metrics.queueDepth = queueDepth_.load();
+    metrics.upgradeBackoffFrames = upgradeBackoffFrames_;
+    metrics.switches = switches_;
+    metrics.framesPerVariant = framesPerVariant_;
+    return metrics;
+}
+
+void AdaptiveSession::Record(size_t variant, double latencyMs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++framesPerVariant_[variant];
+
+    // 切换前已经开始的帧不计入新变体的窗口
+    size_t active = active_.load();
+    if(variant != active)
+        return;
+
+    window_.Add(latencyMs);
+    ++framesSinceSwitch_;
+    if(probing_ && framesSinceSwitch_ >= policy_.upgradeProbeFrames)
+    {
+        // 升级后稳定运行, 恢复正常的升级间隔
+        probing_ = false;
+        upgradeBackoffFrames_ = policy_.minFramesBetweenSwitches;
+    }
+
+    if(framesSinceSwitch_ < policy_.minFramesBetweenSwitches || window_.Size() < policy_.minSamples)
+        return;
+
+    size_t queueDepth = queueDepth_.load();
+    double p95 = window_.Percentile(95);
+    if(ratioPending_)
+        RecordObservedRatio(active, p95);
+
+    bool overBudget = p95 > policy_.targetP95Ms * policy_.downgradeRatio || queueDepth > policy_.maxQueueDepth;
+    if(overBudget && active + 1 < sessions_.size())
+    {
+        if(probing_)
+        {
+            // 升级失败, 加倍下一次升级前的等待帧数
+            upgradeBackoffFrames_ = std::min(std::max<size_t>(1, upgradeBackoffFrames_) * 2, 
+                std::max(policy_.maxUpgradeBackoffFrames, policy_.minFramesBetweenSwitches));
+        }
+        SwitchTo(active + 1);
+        return;
+    }
+
+    // 当前变体的 p95 只说明更快的变体够快, 升级要看更精确的变体预测的延迟
+    if(active == 0 || queueDepth > 0 || framesSinceSwitch_ < upgradeBackoffFrames_)
+        return;
+
+    // 无法预测时(没有预热数据, 也还没有观测到两个变体的开销比)做一次试探性升级, 失败后由退避控制频率
+    double predicted = PredictP95(active - 1, p95);
+    if(predicted == 0 || predicted < policy_.targetP95Ms * policy_.upgradeRatio)
+    {
+        SwitchTo(active - 1);
+        probing_ = true;
+    }
+}
+
+void AdaptiveSession::SwitchTo(size_t variant)
+{
+    size_t previous = active_.load();
+    if(previous < lastP95_.size() && window_.Size() > 0)
+        lastP95_[previous] = window_.Percentile(95);
+
+    active_.store(variant);
+    window_.Clear();
+    framesSinceSwitch_ = 0;
+    probing_ = false;
+    previous_ = previous;
+    ratioPending_ = lastP95_[previous] > 0;
+    ++switches_;
+}
+
+void AdaptiveSession::RecordObservedRatio(size_t active, double activeP95)
+{
+    ratioPending_ = false;
+    if(activeP95 <= 0)
+        return;
+
+    // 切换前后两个窗口的负载接近, 两者 p95 之比近似为开销比; observedRatio_[v] 为 v 相对 v + 1 的比值
+    if(previous_ + 1 == active)
+        observedRatio_[previous_] = lastP95_[previous_] / activeP95;
+    else if(active + 1 == previous_)
+        observedRatio_[active] = activeP95 / lastP95_[previous_];
+}
+
+double AdaptiveSession::PredictP95(size_t variant, double activeP95) const
+{
+    size_t active = active_.load();
+    // 预热延迟之比反映两个变体的计算量之比, 用它缩放当前负载下的 p95
+    if(warmLatencyMs_[variant] > 0 && warmLatencyMs_[active] > 0)
+        return activeP95 * warmLatencyMs_[variant] / warmLatencyMs_[active];
+
+    // 没有预热数据时使用切换前后观测到的开销比
+    if(variant + 1 == active && observedRatio_[variant] > 0)
+        return activeP95 * observedRatio_[variant];
+
+    return 0;
+}
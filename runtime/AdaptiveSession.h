@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ISession.h"
+#include "SessionConfig.h"
+#include "runtime/LatencyWindow.h"
+
+
+/// @brief 一个模型变体, 例如不同输入尺寸(640/320)或不同规模(n/s/m)的导出
+struct ModelVariant
+{
+    std::string name;
+    std::string modelPath;
+    SessionConfig config;
+};
+
+/// @brief 变体切换策略
+struct AdaptivePolicy
+{
+    /// 目标 p95 延迟
+    double targetP95Ms = 100.0;
+
+    /// 计算 p95 的滑动窗口大小
+    size_t windowSize = 50;
+
+    /// 窗口中至少有多少个样本才开始判断
+    size_t minSamples = 20;
+
+    /// p95 超过 targetP95Ms * downgradeRatio 时切换到更快的变体
+    double downgradeRatio = 1.0;
+
+    /// 预测更精确的变体的 p95 低于 targetP95Ms * upgradeRatio 且没有排队时切换回去, 与 downgradeRatio 之间的间隔即滞回区间。
+    /// 预测值为当前变体的 p95 乘以两者的开销比: 优先用预热延迟之比, 没有预热数据时用切换前后观测到的 p95 之比,
+    /// 两者都没有时做一次试探性升级, 升级失败按 upgradeProbeFrames / maxUpgradeBackoffFrames 退避
+    double upgradeRatio = 0.6;
+
+    /// ReportQueueDepth 上报的排队帧数超过该值时切换到更快的变体
+    size_t maxQueueDepth = 2;
+
+    /// 两次切换之间至少间隔的帧数, 防止来回抖动
+    size_t minFramesBetweenSwitches = 30;
+
+    /// 升级后在这么多帧内又降级, 视为升级失败, 下一次升级前的等待帧数加倍
+    size_t upgradeProbeFrames = 200;
+
+    /// 升级失败后等待帧数的上限
+    size_t maxUpgradeBackoffFrames = 3000;
+};
+
+/// @brief 带变体信息的推理结果
+struct AdaptiveResult
+{
+    std::vector<ResultNode> detections;
+    size_t variant = 0;         // 本帧使用的变体下标
+    std::string variantName;
+    double latencyMs = 0;
+};
+
+/// @brief 自适应会话的运行指标
+struct AdaptiveMetrics
+{
+    size_t activeVariant = 0;
+    std::string activeVariantName;
+    double p95Ms = 0;           // 当前变体窗口内的 p95
+    std::vector<double> lastP95PerVariant;  // 每个变体最近一次运行时的 p95, 未运行过为0
+    size_t queueDepth = 0;
+    size_t upgradeBackoffFrames = 0;        // 当前升级前需要等待的帧数
+    uint64_t switches = 0;
+    std::vector<uint64_t> framesPerVariant;
+};
+
+
+/// @brief 持有多个模型变体, 根据滚动 p95 延迟和排队深度自动切换, 以满足延迟目标。
+/// 与 Yolov5Session 一样, 同一个实例不要在多个线程中同时调用 Detect, 排队深度由调用方通过 ReportQueueDepth 上报
+class AdaptiveSession: public ISession
+{
+public:
+    /// @param variants 按精度从高到低(速度从慢到快)排列的变体
+    /// @param policy 切换策略
+    AdaptiveSession(const std::vector<ModelVariant>& variants, const AdaptivePolicy& policy = AdaptivePolicy());
+    ~AdaptiveSession();
+
+    /// @brief 初始化全部变体
+    /// @param modelPath 构造时未提供变体时作为唯一变体, 否则忽略
+    /// @return 所有变体都初始化成功时返回true
+    bool Initialize(const std::string& modelPath) override;
+
+    std::vector<ResultNode> Detect(const cv::Mat& image) override;
+
+    /// @brief 推理并返回本帧使用的变体
+    AdaptiveResult DetectAdaptive(const cv::Mat& image);
+
+    /// @brief 当前变体的模型参数
+    Model* GetModel() override;
+
+    void SetConfidence(float conf) override;
+
+    void SetIOU(float iou) override;
+
+    /// @brief 上报调用方队列中等待的帧数
+    void ReportQueueDepth(size_t depth) { queueDepth_.store(depth); };
+
+    AdaptiveMetrics GetMetrics();
+
+protected:
+    /// @brief 每个变体在自己的 Initialize 中预热
+    bool WarmUpModel() override { return true; };
+
+private:
+    /// @brief 记录一帧的延迟并按策略决定是否切换
+    void Record(size_t variant, double latencyMs);
+
+    void SwitchTo(size_t variant);
+
+    /// @brief 预测切换到更精确的 variant 后的 p95; 需持有 mutex_
+    /// @param variant 目标变体, 比当前变体慢
+    /// @param activeP95 当前变体的 p95
+    /// @return 无法预测时返回0
+    double PredictP95(size_t variant, double activeP95) const;
+
+    /// @brief 用切换前变体的 p95 和当前变体的 p95 记录两者的开销比; 需持有 mutex_
+    void RecordObservedRatio(size_t active, double activeP95);
+
+private:
+    std::vector<ModelVariant> variants_;
+    std::vector<std::unique_ptr<ISession>> sessions_;
+    AdaptivePolicy policy_;
+
+    std::atomic<size_t> active_{0};
+    std::atomic<size_t> queueDepth_{0};
+
+    std::mutex mutex_; // 保护以下成员
+    LatencyWindow window_;                  // 当前变体的延迟窗口
+    std::vector<double> lastP95_;           // 每个变体最近一次运行时的 p95
+    std::vector<double> warmLatencyMs_;     // 每个变体预热稳定后的延迟, 用于估计变体之间的开销比
+    std::vector<double> observedRatio_;     // 切换时观测到的 v 相对 v + 1 的 p95 之比, 0 表示未知
+    size_t previous_ = 0;                   // 切换前的变体
+    bool ratioPending_ = false;             // 新变体的窗口样本足够后记录开销比
+    size_t framesSinceSwitch_ = 0;
+    bool probing_ = false;                  // 刚升级, 尚未经过 upgradeProbeFrames
+    size_t upgradeBackoffFrames_ = 0;
+    uint64_t switches_ = 0;
+    std::vector<uint64_t> framesPerVariant_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+/// @brief 计算百分位数, 在相邻两个样本之间线性插值(会对 samples 排序)。
+/// 调度器、自适应会话和 benchmark 统一使用这一个定义
+/// @param samples 延迟样本, 单位毫秒
+/// @param percentile 百分位, 取值 0~100
+/// @return 返回对应的百分位数, 样本为空时返回0
+inline double Percentile(std::vector<double>& samples, double percentile)
+{
+    if(samples.empty())
+        return 0.0;
+
+    std::sort(samples.begin(), samples.end());
+    double rank = percentile / 100.0 * (samples.size() - 1);
+    size_t low = static_cast<size_t>(std::floor(rank));
+    size_t high = static_cast<size_t>(std::ceil(rank));
+    return samples[low] + (samples[high] - samples[low]) * (rank - low);
+}
+
+
+/// @brief 固定长度的滑动窗口, 保存最近 capacity 个延迟样本。非线程安全, 由调用方加锁
+class LatencyWindow
+{
+public:
+    explicit LatencyWindow(size_t capacity = 100)
+        :capacity_(std::max<size_t>(1, capacity))
+    {
+        samples_.reserve(capacity_);
+    }
+
+    void Add(double ms)
+    {
+        if(samples_.size() < capacity_)
+            samples_.push_back(ms);
+        else
+            samples_[next_] = ms;
+        next_ = (next_ + 1) % capacity_;
+    }
+
+    void Clear()
+    {
+        samples_.clear();
+        next_ = 0;
+    }
+
+    size_t Size() const { return samples_.size(); };
+
+    bool Full() const { return samples_.size() == capacity_; };
+
+    /// @brief 计算百分位数
+    /// @param percentile 取值 0~100
+    /// @return 窗口为空时返回0
+    double Percentile(double percentile) const
+    {
+        std::vector<double> sorted = samples_;
+        return ::Percentile(sorted, percentile);
+    }
+
+    double Mean() const
+    {
+        if(samples_.empty())
+            return 0.0;
+
+        double sum = 0;
+        for(double sample : samples_)
+            sum += sample;
+        return sum / samples_.size();
+    }
+
+private:
+    size_t capacity_;
+    size_t next_ = 0;
+    std::vector<double> samples_;
+};
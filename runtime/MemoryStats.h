@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+#include <malloc.h>
+#include <unistd.h>
+
+
+/// @brief glibc malloc 的统计
+struct HeapStats
+{
+    size_t arenaBytes = 0;  // 通过 brk 向系统申请的堆大小
+    size_t mmapBytes = 0;   // 通过 mmap 申请的大块内存
+    size_t inUseBytes = 0;  // 已分配未释放的内存
+    size_t freeBytes = 0;   // 堆中空闲但未归还系统的内存
+};
+
+
+/// @brief 当前进程的常驻内存(RSS), 读取自 /proc/self/statm
+/// @return 返回字节数, 读取失败时返回0
+inline size_t CurrentRssBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if(!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+/// @brief 当前进程的 RSS 峰值(VmHWM), 读取自 /proc/self/status
+/// @return 返回字节数, 读取失败时返回0
+inline size_t PeakRssBytes()
+{
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while(status >> key)
+    {
+        if(key == "VmHWM:")
+        {
+            size_t kb = 0;
+            status >> kb;
+            return kb * 1024;
+        }
+        status.ignore(4096, '\n');
+    }
+    return 0;
+}
+
+/// @brief 读取 malloc 统计, glibc 2.33 之前的 mallinfo 字段为 int, 超过 2GB 时会溢出
+inline HeapStats CurrentHeapStats()
+{
+    HeapStats stats;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    stats.arenaBytes = static_cast<size_t>(info.arena);
+    stats.mmapBytes = static_cast<size_t>(info.hblkhd);
+    stats.inUseBytes = static_cast<size_t>(info.uordblks) + static_cast<size_t>(info.hblkhd);
+    stats.freeBytes = static_cast<size_t>(info.fordblks);
+    return stats;
+}
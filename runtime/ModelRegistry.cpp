@@ -0,0 +1,216 @@
+#include "ModelRegistry.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#include "runtime/MemoryStats.h"
+#include "yolov5/Yolov5Session.h"
+
+
+ModelRegistry::ModelRegistry(size_t memoryBudgetBytes, SessionFactory factory)
+    :memoryBudgetBytes_(memoryBudgetBytes), factory_(factory)
+{
+    if(!factory_)
+        factory_ = [](const SessionConfig& config) -> ISession* { return new Yolov5Session(config); };
+}
+
+bool ModelRegistry::Register(const std::string& modelId, const std::string& modelPath,
+    const SessionConfig& config, bool keepWarm)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(entries_.count(modelId))
+        return false;
+
+    Entry& entry = entries_[modelId];
+    entry.modelPath = modelPath;
+    entry.config = config;
+    entry.keepWarm = keepWarm;
+    return true;
+}
+
+std::shared_ptr<ISession> ModelRegistry::Acquire(const std::string& modelId)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(modelId);
+    if(it == entries_.end())
+        return nullptr;
+
+    // std::map 的元素地址在插入其他元素后保持不变
+    Entry& entry = it->second;
+    // 等待其他线程正在进行的加载; 该次加载失败时直接返回, 不再逐个重复同样会失败的加载
+    bool waited = entry.loading;
+    uint64_t failures = entry.loadFailures;
+    loaded_.wait(lock, [&entry]() { return !entry.loading; });
+    if(waited && !entry.session && entry.loadFailures != failures)
+        return nullptr;
+
+    entry.lastUsed = ++clock_;
+    if(entry.session)
+    {
+        ++metrics_.hits;
+        std::shared_ptr<ISession> session = entry.session;
+        // 上次加载时其他会话可能正忙而未能卸载, 命中时重新检查预算
+        std::vector<std::shared_ptr<ISession>> evicted = EnforceBudget(modelId);
+        lock.unlock();
+        evicted.clear();
+        return session;
+    }
+
+    ++metrics_.misses;
+    entry.loading = true;
+    Entry snapshot = entry;
+    lock.unlock();
+
+    // 加载可能耗时数秒, 期间不阻塞其他模型的请求
+    size_t memoryBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<ISession> session = Load(snapshot, memoryBytes);
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::shared_ptr<ISession>> evicted;
+    lock.lock();
+    entry.loading = false;
+    if(session)
+    {
+        entry.session = session;
+        entry.memoryBytes = memoryBytes;
+        residentBytes_ += memoryBytes;
+        ++metrics_.loads;
+        metrics_.totalLoadMs += loadMs;
+        evicted = EnforceBudget(modelId);
+    }else{
+        ++entry.loadFailures;
+        ++metrics_.loadFailures;
+    }
+    lock.unlock();
+    loaded_.notify_all();
+
+    // 被卸载的会话在锁外析构
+    evicted.clear();
+    return session;
+}
+
+void ModelRegistry::SetKeepWarm(const std::string& modelId, bool keepWarm)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(modelId);
+    if(it != entries_.end())
+        it->second.keepWarm = keepWarm;
+}
+
+bool ModelRegistry::Preload()
+{
+    std::vector<std::string> warmIds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(const auto& it : entries_)
+        {
+            if(it.second.keepWarm)
+                warmIds.push_back(it.first);
+        }
+    }
+
+    bool valid = true;
+    for(const auto& modelId : warmIds)
+        valid = Acquire(modelId) != nullptr && valid;
+    return valid;
+}
+
+size_t ModelRegistry::EvictIdle()
+{
+    std::vector<std::shared_ptr<ISession>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto& it : entries_)
+        {
+            Entry& entry = it.second;
+            if(entry.keepWarm || !IsIdle(entry))
+                continue;
+
+            residentBytes_ -= entry.memoryBytes;
+            entry.memoryBytes = 0;
+            evicted.push_back(std::move(entry.session));
+            ++metrics_.evictions;
+        }
+    }
+    return evicted.size();
+}
+
+RegistryMetrics ModelRegistry::GetMetrics()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    RegistryMetrics metrics = metrics_;
+    metrics.loadedModels = 0;
+    for(const auto& it : entries_)
+    {
+        if(it.second.session)
+            ++metrics.loadedModels;
+    }
+    metrics.residentBytes = residentBytes_;
+    metrics.memoryBudgetBytes = memoryBudgetBytes_;
+    return metrics;
+}
+
+std::shared_ptr<ISession> ModelRegistry::Load(const Entry& entry, size_t& memoryBytes)
+{
+    size_t rssBefore = CurrentRssBytes();
+    std::shared_ptr<ISession> session(factory_(entry.config));
+    if(!session || !session->Initialize(entry.modelPath))
+    {
+        std::cerr << "failed to load model: " << entry.modelPath << "\n";
+        return nullptr;
+    }
+    size_t rssAfter = CurrentRssBytes();
+
+    // RSS 增量在并发加载时不准确, 至少按模型文件大小估计
+    std::error_code error;
+    size_t fileBytes = static_cast<size_t>(std::filesystem::file_size(entry.modelPath, error));
+    if(error)
+        fileBytes = 0;
+    memoryBytes = std::max(rssAfter > rssBefore ? rssAfter - rssBefore : 0, fileBytes);
+    return session;
+}
+
+std::vector<std::shared_ptr<ISession>> ModelRegistry::EnforceBudget(const std::string& keepId)
+{
+    std::vector<std::shared_ptr<ISession>> evicted;
+    if(memoryBudgetBytes_ == 0)
+        return evicted;
+
+    while(residentBytes_ > memoryBudgetBytes_)
+    {
+        Entry* victim = nullptr;
+        for(auto& it : entries_)
+        {
+            Entry& entry = it.second;
+            if(it.first == keepId || entry.keepWarm || !IsIdle(entry))
+                continue;
+            if(!victim || entry.lastUsed < victim->lastUsed)
+                victim = &entry;
+        }
+
+        if(!victim)
+        {
+            // 命中时也会检查预算, 只在第一次无法卸载时输出
+            if(!overBudgetReported_)
+                std::cerr << "model registry over budget: " << residentBytes_ << " > " << memoryBudgetBytes_
+                          << " bytes, no idle model to evict\n";
+            overBudgetReported_ = true;
+            return evicted;
+        }
+
+        residentBytes_ -= victim->memoryBytes;
+        victim->memoryBytes = 0;
+        evicted.push_back(std::move(victim->session));
+        ++metrics_.evictions;
+    }
+    overBudgetReported_ = false;
+    return evicted;
+}
+
+bool ModelRegistry::IsIdle(const Entry& entry) const
+{
+    // 只有注册表自己持有时为空闲; 新的引用只会在持有 mutex_ 时产生
+    return entry.session && !entry.loading && entry.session.use_count() == 1;
+}
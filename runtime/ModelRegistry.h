@@ -0,0 +1,105 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ISession.h"
+#include "SessionConfig.h"
+
+
+/// @brief 模型注册表的运行指标
+struct RegistryMetrics
+{
+    uint64_t hits = 0;          // 请求时模型已加载
+    uint64_t misses = 0;        // 请求时需要加载
+    uint64_t loads = 0;         // 加载成功次数
+    uint64_t loadFailures = 0;
+    uint64_t evictions = 0;
+    double totalLoadMs = 0;
+    size_t loadedModels = 0;
+    size_t residentBytes = 0;   // 已加载模型的估计内存之和
+    size_t memoryBudgetBytes = 0;
+};
+
+/// @brief 创建会话的工厂, 默认创建 Yolov5Session
+using SessionFactory = std::function<ISession*(const SessionConfig&)>;
+
+
+/// @brief 多模型注册表: 模型编号 -> onnx 路径, 第一次请求时加载, 调用方通过 shared_ptr 共享会话。
+/// 已加载模型的估计内存超过预算时, 按最久未使用的顺序卸载空闲(没有调用方持有)的会话
+class ModelRegistry
+{
+public:
+    /// @param memoryBudgetBytes 内存预算, 0 表示不限制
+    /// @param factory 创建会话的工厂, 为空时使用 Yolov5Session
+    explicit ModelRegistry(size_t memoryBudgetBytes = 0, SessionFactory factory = nullptr);
+    ~ModelRegistry() = default;
+
+    /// @brief 注册模型, 不会立即加载
+    /// @param modelId 模型编号
+    /// @param modelPath onnx 路径
+    /// @param config 会话配置
+    /// @param keepWarm 常用模型: 不会被卸载, 并在 Preload 时提前加载
+    /// @return 编号已存在时返回false
+    bool Register(const std::string& modelId, const std::string& modelPath,
+        const SessionConfig& config = SessionConfig(), bool keepWarm = false);
+
+    /// @brief 获取模型对应的会话, 未加载时在当前线程加载; 同一模型的并发请求只加载一次,
+    /// 加载失败时等待该次加载的请求一起返回 nullptr, 之后的新请求会重新尝试加载
+    /// @param modelId 模型编号
+    /// @return 未注册或加载失败时返回 nullptr
+    std::shared_ptr<ISession> Acquire(const std::string& modelId);
+
+    /// @brief 设置是否常驻
+    void SetKeepWarm(const std::string& modelId, bool keepWarm);
+
+    /// @brief 加载所有常驻模型
+    /// @return 全部加载成功时返回true
+    bool Preload();
+
+    /// @brief 卸载所有空闲且非常驻的模型
+    /// @return 返回卸载的数量
+    size_t EvictIdle();
+
+    RegistryMetrics GetMetrics();
+
+private:
+    struct Entry
+    {
+        std::string modelPath;
+        SessionConfig config;
+        bool keepWarm = false;
+        bool loading = false;
+        std::shared_ptr<ISession> session;
+        size_t memoryBytes = 0;
+        uint64_t lastUsed = 0;  // 逻辑时钟, 越大越新
+        uint64_t loadFailures = 0;
+    };
+
+    /// @brief 加载会话并估计其内存, 不持有 mutex_
+    std::shared_ptr<ISession> Load(const Entry& entry, size_t& memoryBytes);
+
+    /// @brief 超出预算时卸载 LRU 的空闲会话, 在加载和命中时调用; 需持有 mutex_
+    /// @param keepId 刚加载或命中的模型, 不参与卸载
+    /// @return 返回被卸载的会话, 由调用方在锁外析构
+    std::vector<std::shared_ptr<ISession>> EnforceBudget(const std::string& keepId);
+
+    bool IsIdle(const Entry& entry) const;
+
+private:
+    size_t memoryBudgetBytes_;
+    SessionFactory factory_;
+
+    std::mutex mutex_; // 保护以下成员
+    std::condition_variable loaded_;
+    std::map<std::string, Entry> entries_;
+    uint64_t clock_ = 0;
+    size_t residentBytes_ = 0;
+    bool overBudgetReported_ = false;
+    RegistryMetrics metrics_;
+};
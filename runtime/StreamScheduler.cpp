@@ -0,0 +1,256 @@
+#include "StreamScheduler.h"
+
+#include <iostream>
+
+
+StreamScheduler::StreamScheduler(const std::vector<ISession*>& sessions, const SchedulerConfig& config)
+    :config_(config)
+{
+    config_.maxBatchSize = std::max<size_t>(1, config_.maxBatchSize);
+    config_.maxQueuePerStream = std::max<size_t>(1, config_.maxQueuePerStream);
+
+    for(auto* session : sessions)
+        workers_.emplace_back(&StreamScheduler::WorkerLoop, this, session);
+}
+
+StreamScheduler::~StreamScheduler()
+{
+    Stop();
+}
+
+void StreamScheduler::AddStream(int streamId, uint32_t weight)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    EnsureStream(streamId).weight = std::max<uint32_t>(1, weight);
+}
+
+bool StreamScheduler::Submit(int streamId, const cv::Mat& image, std::chrono::steady_clock::time_point deadline, StreamCallback callback)
+{
+    std::vector<Frame> overflow;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(stopping_)
+            return false;
+
+        Stream& stream = EnsureStream(streamId);
+        // 实时流中新帧比旧帧更有价值, 队列满时丢弃最旧的一帧
+        while(stream.queue.size() >= config_.maxQueuePerStream)
+        {
+            overflow.push_back(std::move(stream.queue.front()));
+            stream.queue.pop_front();
+            ++stream.stats.droppedOverflow;
+            --queued_;
+        }
+
+        stream.queue.push_back(Frame{streamId, stream.nextFrameId++, image, Clock::now(), deadline, std::move(callback)});
+        ++stream.stats.submitted;
+        ++queued_;
+    }
+
+    frameReady_.notify_one();
+    NotifyDropped(overflow);
+    return true;
+}
+
+void StreamScheduler::Stop()
+{
+    std::vector<Frame> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for(auto& it : streams_)
+        {
+            for(auto& frame : it.second.queue)
+                remaining.push_back(std::move(frame));
+            it.second.queue.clear();
+        }
+        queued_ = 0;
+    }
+
+    frameReady_.notify_all();
+    for(auto& worker : workers_)
+    {
+        if(worker.joinable())
+            worker.join();
+    }
+    NotifyDropped(remaining);
+}
+
+StreamStats StreamScheduler::GetStats(int streamId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(streamId);
+    return it == streams_.end() ? StreamStats() : MakeStats(it->second);
+}
+
+std::map<int, StreamStats> StreamScheduler::GetAllStats()
+{
+    std::map<int, StreamStats> stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(const auto& it : streams_)
+        stats[it.first] = MakeStats(it.second);
+    return stats;
+}
+
+void StreamScheduler::WorkerLoop(ISession* session)
+{
+    // 会话可能仍在后台初始化, 就绪前不取帧, 否则帧会被当作"没有目标"处理; 初始化失败时该工作线程不再取帧
+    while(!session->WaitReady(std::chrono::milliseconds(100)))
+    {
+        if(session->GetState() == SessionState::Failed)
+        {
+            std::cerr << "stream scheduler: session failed to initialize, worker exits\n";
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(stopping_)
+            return;
+    }
+
+    // 不能批量推理的会话每次只取一帧, 否则一个线程串行处理多帧而其他工作线程空闲, 后面的帧也可能在等待中超时
+    const size_t maxFrames = std::max<size_t>(1, std::min(config_.maxBatchSize, session->MaxBatch()));
+    while(true)
+    {
+        std::vector<Frame> frames, expired;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            frameReady_.wait(lock, [this]() { return stopping_ || queued_ > 0; });
+            if(stopping_)
+                break;
+            frames = PickFrames(maxFrames, expired);
+        }
+        NotifyDropped(expired);
+        if(frames.empty())
+            continue;
+
+        std::vector<std::vector<ResultNode>> results;
+        if(frames.size() == 1)
+        {
+            results.push_back(session->Detect(frames[0].image));
+        }else{
+            std::vector<cv::Mat> images;
+            for(const auto& frame : frames)
+                images.push_back(frame.image);
+            results = session->DetectBatch(images);
+        }
+        auto done = Clock::now();
+
+        std::vector<StreamResult> outputs(frames.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(size_t idx = 0; idx < frames.size(); ++idx)
+            {
+                const Frame& frame = frames[idx];
+                StreamResult& output = outputs[idx];
+                output.streamId = frame.streamId;
+                output.frameId = frame.frameId;
+                output.latencyMs = std::chrono::duration<double, std::milli>(done - frame.submitted).count();
+                if(idx < results.size())
+                    output.detections = std::move(results[idx]);
+
+                Stream& stream = streams_[frame.streamId];
+                ++stream.stats.processed;
+                if(done > frame.deadline)
+                    ++stream.stats.late;
+                stream.latency.Add(output.latencyMs);
+            }
+        }
+
+        for(size_t idx = 0; idx < frames.size(); ++idx)
+        {
+            if(frames[idx].callback)
+                frames[idx].callback(outputs[idx]);
+        }
+    }
+}
+
+std::vector<StreamScheduler::Frame> StreamScheduler::PickFrames(size_t maxFrames, std::vector<Frame>& expired)
+{
+    std::vector<Frame> picked;
+    auto now = Clock::now();
+
+    // 先移除所有已超时的帧, 保证不为它们花费推理
+    for(auto& it : streams_)
+    {
+        auto& queue = it.second.queue;
+        for(auto frame = queue.begin(); frame != queue.end();)
+        {
+            if(frame->deadline < now)
+            {
+                expired.push_back(std::move(*frame));
+                frame = queue.erase(frame);
+                ++it.second.stats.droppedDeadline;
+                --queued_;
+            }else
+                ++frame;
+        }
+    }
+
+    // 轮询每个流, 每次访问取一帧并消耗一个额度; 所有有帧的流额度都用完时按权重重新发放
+    while(picked.size() < maxFrames && queued_ > 0)
+    {
+        bool served = false;
+        for(size_t visited = 0; visited < order_.size() && picked.size() < maxFrames; ++visited)
+        {
+            Stream& stream = streams_[order_[cursor_]];
+            cursor_ = (cursor_ + 1) % order_.size();
+            if(stream.queue.empty() || stream.credit == 0)
+                continue;
+
+            picked.push_back(std::move(stream.queue.front()));
+            stream.queue.pop_front();
+            --stream.credit;
+            --queued_;
+            served = true;
+        }
+
+        if(!served)
+        {
+            for(auto& it : streams_)
+                it.second.credit = config_.policy == SchedulingPolicy::Weighted ? it.second.weight : 1;
+        }
+    }
+
+    return picked;
+}
+
+void StreamScheduler::NotifyDropped(std::vector<Frame>& frames)
+{
+    auto now = Clock::now();
+    for(auto& frame : frames)
+    {
+        if(!frame.callback)
+            continue;
+
+        StreamResult result;
+        result.streamId = frame.streamId;
+        result.frameId = frame.frameId;
+        result.dropped = true;
+        result.latencyMs = std::chrono::duration<double, std::milli>(now - frame.submitted).count();
+        frame.callback(result);
+    }
+}
+
+StreamScheduler::Stream& StreamScheduler::EnsureStream(int streamId)
+{
+    auto it = streams_.find(streamId);
+    if(it == streams_.end())
+    {
+        it = streams_.try_emplace(streamId).first;
+        it->second.created = Clock::now();
+        it->second.latency = LatencyWindow(config_.latencyWindow);
+        order_.push_back(streamId);
+    }
+    return it->second;
+}
+
+StreamStats StreamScheduler::MakeStats(const Stream& stream)
+{
+    StreamStats stats = stream.stats;
+    double seconds = std::chrono::duration<double>(Clock::now() - stream.created).count();
+    stats.throughputFps = seconds > 0 ? stats.processed / seconds : 0;
+    stats.p50Ms = stream.latency.Percentile(50);
+    stats.p95Ms = stream.latency.Percentile(95);
+    return stats;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "ISession.h"
+#include "runtime/LatencyWindow.h"
+
+
+/// @brief 流之间的调度方式
+enum class SchedulingPolicy
+{
+    RoundRobin, // 每个流轮流取一帧
+    Weighted    // 按流的权重取帧(deficit round robin)
+};
+
+/// @brief 调度器配置
+struct SchedulerConfig
+{
+    SchedulingPolicy policy = SchedulingPolicy::RoundRobin;
+
+    /// 一次推理最多合并的帧数, 实际上限还受会话的 ISession::MaxBatch 限制
+    size_t maxBatchSize = 1;
+
+    /// 每个流最多排队的帧数, 超过时丢弃该流最旧的帧
+    size_t maxQueuePerStream = 8;
+
+    /// 计算延迟分位数的窗口大小
+    size_t latencyWindow = 200;
+};
+
+/// @brief 一帧的处理结果, 超过截止时间被丢弃的帧 dropped 为true 且没有检测结果
+struct StreamResult
+{
+    int streamId = 0;
+    uint64_t frameId = 0;
+    bool dropped = false;
+    std::vector<ResultNode> detections;
+    double latencyMs = 0;   // 从提交到得到结果的时间(包含排队)
+};
+
+using StreamCallback = std::function<void(const StreamResult&)>;
+
+/// @brief 单个流的统计
+struct StreamStats
+{
+    uint64_t submitted = 0;
+    uint64_t processed = 0;
+    uint64_t droppedDeadline = 0;   // 推理前已经超过截止时间
+    uint64_t droppedOverflow = 0;   // 队列已满被挤掉
+    uint64_t late = 0;              // 完成时已经超过截止时间
+    double throughputFps = 0;
+    double p50Ms = 0;
+    double p95Ms = 0;
+};
+
+
+/// @brief 多路视频流调度器: 按流公平排队, 在会话池上分发推理, 推理前丢弃已超时的帧, 并在可能时合并为批量推理。
+/// 每个会话由一个工作线程独占, 会话可以仍在后台初始化(InitializeAsync), 工作线程等到会话就绪后才开始取帧,
+/// 初始化失败的会话不参与调度; 会话的生命周期由调用方管理且需长于调度器
+class StreamScheduler
+{
+public:
+    StreamScheduler(const std::vector<ISession*>& sessions, const SchedulerConfig& config = SchedulerConfig());
+    ~StreamScheduler();
+
+    /// @brief 注册一个流, 未注册的流在第一次提交时以权重1自动注册
+    /// @param streamId 流编号
+    /// @param weight Weighted 模式下每轮可以取的帧数
+    void AddStream(int streamId, uint32_t weight = 1);
+
+    /// @brief 提交一帧
+    /// @param streamId 流编号
+    /// @param image 图像, 调用方不应再修改
+    /// @param deadline 截止时间, 到期仍未开始推理的帧会被丢弃
+    /// @param callback 在工作线程中回调结果
+    /// @return 调度器已停止时返回false
+    bool Submit(int streamId, const cv::Mat& image, std::chrono::steady_clock::time_point deadline, StreamCallback callback);
+
+    /// @brief 停止所有工作线程, 队列中剩余的帧按丢弃回调
+    void Stop();
+
+    StreamStats GetStats(int streamId);
+
+    std::map<int, StreamStats> GetAllStats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame
+    {
+        int streamId;
+        uint64_t frameId;
+        cv::Mat image;
+        Clock::time_point submitted;
+        Clock::time_point deadline;
+        StreamCallback callback;
+    };
+
+    struct Stream
+    {
+        uint32_t weight = 1;
+        uint32_t credit = 0;
+        std::deque<Frame> queue;
+        uint64_t nextFrameId = 0;
+        Clock::time_point created;
+        StreamStats stats;
+        LatencyWindow latency;
+    };
+
+    /// @brief 获取流, 不存在时以权重1创建; 需持有 mutex_
+    Stream& EnsureStream(int streamId);
+
+    void WorkerLoop(ISession* session);
+
+    /// @brief 按公平策略取出最多 maxFrames 帧, 顺带移除已超时的帧; 需持有 mutex_
+    std::vector<Frame> PickFrames(size_t maxFrames, std::vector<Frame>& expired);
+
+    /// @brief 回调被丢弃的帧, 不能持有 mutex_
+    void NotifyDropped(std::vector<Frame>& frames);
+
+    StreamStats MakeStats(const Stream& stream);
+
+private:
+    SchedulerConfig config_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_; // 保护以下成员
+    std::condition_variable frameReady_;
+    std::map<int, Stream> streams_;
+    std::vector<int> order_;    // 轮询顺序
+    size_t cursor_ = 0;
+    size_t queued_ = 0;
+    bool stopping_ = false;
+};
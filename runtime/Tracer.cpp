@@ -0,0 +1,211 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace
+{
+    thread_local bool frameSampled = false;
+}
+
+Tracer& Tracer::Instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::Enable(uint32_t sampleEvery, size_t eventsPerThread)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        eventsPerThread_ = eventsPerThread;
+    }
+    sampleEvery_.store(sampleEvery == 0 ? 1 : sampleEvery);
+
+    bool expected = false;
+    if(enabled_.compare_exchange_strong(expected, true))
+        originNs_.store(NowNs());
+}
+
+void Tracer::Disable()
+{
+    enabled_.store(false);
+}
+
+bool Tracer::BeginFrame()
+{
+    frameSampled = IsEnabled() && frameCounter_.fetch_add(1, std::memory_order_relaxed) % sampleEvery_.load(std::memory_order_relaxed) == 0;
+    return frameSampled;
+}
+
+bool Tracer::IsActive() const
+{
+    return frameSampled && IsEnabled();
+}
+
+void Tracer::Record(const char* name, int64_t startNs, int64_t endNs)
+{
+    ThreadBuffer* buffer = GetThreadBuffer();
+    if(buffer->slots.empty())
+        return;
+
+    // 只有所属线程写入, count 用 release 发布, 输出时 acquire 读取即可。
+    // 覆盖槽位前的 release fence 与 Snapshot 中的 acquire fence 配对: 读到本次写入的值时, 之后重读的 count 至少为 idx
+    uint64_t idx = buffer->count.load(std::memory_order_relaxed);
+    EventSlot& slot = buffer->slots[idx % buffer->slots.size()];
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+    buffer->count.store(idx + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> Tracer::Snapshot(const ThreadBuffer& buffer, uint64_t& overwritten)
+{
+    const uint64_t capacity = buffer.slots.size();
+    uint64_t end = buffer.count.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    std::vector<TraceEvent> events;
+    events.reserve(end - begin);
+    for(uint64_t idx = begin; idx < end; ++idx)
+    {
+        const EventSlot& slot = buffer.slots[idx % capacity];
+        events.push_back(TraceEvent{slot.name.load(std::memory_order_relaxed),
+            slot.startNs.load(std::memory_order_relaxed), slot.durationNs.load(std::memory_order_relaxed)});
+    }
+
+    // 读取期间所属线程可能继续写入: 写到第 n 个事件时会覆盖第 n - capacity 个, 这些位置读到的值不可信
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = buffer.count.load(std::memory_order_relaxed);
+    uint64_t validBegin = now >= capacity ? now - capacity + 1 : 0;
+    size_t skip = validBegin > begin ? static_cast<size_t>(std::min(validBegin - begin, end - begin)) : 0;
+    events.erase(events.begin(), events.begin() + skip);
+
+    overwritten += begin + skip;
+    return events;
+}
+
+void Tracer::AddOrtProfile(const std::string& path, int64_t startNs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ortProfiles_.push_back(OrtProfile{path, startNs});
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if(!file)
+    {
+        std::cerr << "failed to open trace file: " << path << "\n";
+        return false;
+    }
+
+    const int64_t originNs = originNs_.load();
+    const int pid = static_cast<int>(getpid());
+    std::string events;
+    bool first = true;
+    uint64_t overwritten = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(const auto& buffer : buffers_)
+    {
+        for(const auto& event : Snapshot(*buffer, overwritten))
+        {
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(3)
+                 << (first ? "" : ",\n")
+                 << "{\"name\":\"" << event.name << "\",\"cat\":\"pipeline\",\"ph\":\"X\""
+                 << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                 << ",\"ts\":" << (event.startNs - originNs) / 1000.0
+                 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+            events += line.str();
+            first = false;
+        }
+    }
+
+    for(const auto& profile : ortProfiles_)
+        AppendOrtEvents(profile, events, first);
+
+    file << "{\"traceEvents\":[\n" << events << "\n],\"displayTimeUnit\":\"ms\""
+         << ",\"otherData\":{\"sampleEvery\":" << sampleEvery_.load()
+         << ",\"overwrittenEvents\":" << overwritten << "}}\n";
+
+    return static_cast<bool>(file);
+}
+
+int64_t Tracer::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+Tracer::ThreadBuffer* Tracer::GetThreadBuffer()
+{
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+    if(threadBuffer)
+        return threadBuffer;
+
+    // 每个线程只在第一次记录时加锁注册, 缓冲区由 Tracer 持有, 线程退出后仍可输出
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(new ThreadBuffer(eventsPerThread_));
+    threadBuffer = buffers_.back().get();
+    threadBuffer->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    return threadBuffer;
+}
+
+bool Tracer::AppendOrtEvents(const OrtProfile& profile, std::string& out, bool& first)
+{
+    std::ifstream file(profile.path);
+    if(!file)
+    {
+        std::cerr << "failed to open ort profile: " << profile.path << "\n";
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // onnxruntime 输出为 [ {...}, {...} ], ts 以该会话开始 profiling 的时间为原点, 单位微秒
+    size_t begin = content.find('{');
+    size_t end = content.rfind('}');
+    if(begin == std::string::npos || end == std::string::npos || end < begin)
+        return false;
+    content = content.substr(begin, end - begin + 1);
+
+    const int64_t offsetUs = (profile.startNs - originNs_.load()) / 1000;
+    const std::string key = "\"ts\"";
+    std::string shifted;
+    size_t pos = 0;
+    while(true)
+    {
+        size_t keyPos = content.find(key, pos);
+        if(keyPos == std::string::npos)
+            break;
+
+        size_t valuePos = keyPos + key.size();
+        while(valuePos < content.size() && (content[valuePos] == ' ' || content[valuePos] == ':'))
+            ++valuePos;
+        size_t valueEnd = valuePos;
+        while(valueEnd < content.size() && std::isdigit(static_cast<unsigned char>(content[valueEnd])))
+            ++valueEnd;
+
+        shifted.append(content, pos, valuePos - pos);
+        if(valueEnd > valuePos)
+            shifted += std::to_string(std::stoll(content.substr(valuePos, valueEnd - valuePos)) + offsetUs);
+        pos = valueEnd;
+    }
+    shifted.append(content, pos, std::string::npos);
+
+    out += (first ? "" : ",\n") + shifted;
+    first = false;
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/// @brief 一个耗时区间
+struct TraceEvent
+{
+    const char* name;   // 必须是静态字符串
+    int64_t startNs;
+    int64_t durationNs;
+};
+
+
+/// @brief 进程级的流水线耗时记录, 输出 Chrome trace / Perfetto 可读取的 JSON。
+/// 每个线程写自己的环形缓冲区, 记录时不加锁, 写满后覆盖最旧的事件, 长时间运行时保留的是最近的帧;
+/// 按帧采样, 未被采样的帧只有一次 thread_local 判断的开销
+class Tracer
+{
+public:
+    static Tracer& Instance();
+
+    /// @brief 开启记录
+    /// @param sampleEvery 每 sampleEvery 帧记录一帧, 1 表示每帧都记录
+    /// @param eventsPerThread 每个线程缓冲区能容纳的事件数, 写满后覆盖最旧的事件
+    void Enable(uint32_t sampleEvery = 1, size_t eventsPerThread = 1 << 16);
+
+    void Disable();
+
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); };
+
+    /// @brief 每帧开始时调用, 决定当前线程接下来的区间是否记录
+    /// @return 返回这一帧是否被采样
+    bool BeginFrame();
+
+    /// @brief 当前线程的这一帧是否需要记录
+    bool IsActive() const;
+
+    /// @brief 记录一个区间到当前线程的缓冲区
+    void Record(const char* name, int64_t startNs, int64_t endNs);
+
+    /// @brief 添加一个 onnxruntime 生成的 profiling 文件, 输出时合并到同一条时间线上
+    /// @param path EndProfiling 返回的文件路径
+    /// @param startNs 该会话开始 profiling 的时间(GetProfilingStartTimeNs)
+    void AddOrtProfile(const std::string& path, int64_t startNs);
+
+    /// @brief 写出各线程缓冲区中最近的事件, 可以在运行中多次调用
+    /// @param path 输出路径
+    /// @return 返回是否写入成功
+    bool WriteChromeTrace(const std::string& path);
+
+    /// @brief 与 onnxruntime profiler 相同的时钟(high_resolution_clock)
+    static int64_t NowNs();
+
+private:
+    /// 字段为原子变量, 输出线程读取时所属线程可能正在覆盖同一个位置
+    struct EventSlot
+    {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<int64_t> startNs{0};
+        std::atomic<int64_t> durationNs{0};
+    };
+
+    struct ThreadBuffer
+    {
+        explicit ThreadBuffer(size_t capacity) :slots(capacity) {};
+
+        std::vector<EventSlot> slots;
+        std::atomic<uint64_t> count{0};   // 累计写入的事件数, 第 i 个事件位于 slots[i % slots.size()]
+        uint32_t tid = 0;
+    };
+
+    struct OrtProfile
+    {
+        std::string path;
+        int64_t startNs;
+    };
+
+    Tracer() = default;
+
+    ThreadBuffer* GetThreadBuffer();
+
+    /// @brief 读取缓冲区中仍然有效的最近事件
+    /// @param overwritten 累加已被覆盖的事件数
+    static std::vector<TraceEvent> Snapshot(const ThreadBuffer& buffer, uint64_t& overwritten);
+
+    /// @brief 将 onnxruntime profiling 文件中的事件平移到当前时间原点后追加到 out
+    bool AppendOrtEvents(const OrtProfile& profile, std::string& out, bool& first);
+
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint32_t> sampleEvery_{1};
+    std::atomic<uint64_t> frameCounter_{0};
+    std::atomic<int64_t> originNs_{0};
+    size_t eventsPerThread_ = 1 << 16;
+
+    std::mutex mutex_; // 只保护缓冲区的注册和 ort profiling 列表
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    std::vector<OrtProfile> ortProfiles_;
+};
+
+
+/// @brief RAII 方式记录一个区间, 当前帧未被采样时不做任何事
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+        :name_(name), active_(Tracer::Instance().IsActive())
+    {
+        if(active_)
+            startNs_ = Tracer::NowNs();
+    }
+
+    ~TraceScope()
+    {
+        if(active_)
+            Tracer::Instance().Record(name_, startNs_, Tracer::NowNs());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    bool active_;
+    int64_t startNs_ = 0;
+};
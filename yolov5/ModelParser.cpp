@@ -1,15 +1,25 @@
 #include "ModelParser.h"
+#include "YoloDefine.h"
+
+#include <cctype>
+#include <iostream>
 
 
 Model* ModelParser::parse(Ort::Session* session)
 {
-    Model* model = new Model();
     if(session == nullptr)
         return nullptr;
 
-    bool valid = parseInput(session, model) && parseOutput(session, model) && parseLabels(session, model); 
+    Model* model = new Model();
+    bool valid = parseInput(session, model) && parseOutput(session, model) && parseLabels(session, model)
+        && parseAnchors(session, model); 
+    if(!valid)
+    {
+        delete model;
+        return nullptr;
+    }
 
-    return valid ? model : nullptr;
+    return model;
 }
 
 bool ModelParser::parseInput(Ort::Session* session, Model* model)
@@ -25,17 +35,41 @@ bool ModelParser::parseInput(Ort::Session* session, Model* model)
     {
         auto name = session->GetInputNameAllocated(idx, allocator);
         model->inputNames.push_back(name.get());
-        model->inputNamesPtr.push_back(model->inputNames.back().c_str());
        
         auto TypeInfo = session->GetInputTypeInfo(idx);
         auto TypeAndShape = TypeInfo.GetTensorTypeAndShapeInfo();
 
-        model->inputShapes.emplace_back(TypeAndShape.GetShape());
+        auto shape = TypeAndShape.GetShape();
+        resolveDynamicShape(shape, model);
+        model->inputShapes.emplace_back(shape);
     } 
 
+    // inputNames 扩容时短字符串会随之移动, 需要在全部名字加入后再取指针
+    for(const auto& name : model->inputNames)
+        model->inputNamesPtr.push_back(name.c_str());
+
     return true;
 }
 
+void ModelParser::resolveDynamicShape(std::vector<int64_t>& shape, Model* model)
+{
+    // NCHW, 动态导出时 batch/height/width 为 -1
+    for(size_t idx = 0; idx < shape.size(); ++idx)
+    {
+        if(shape[idx] > 0)
+            continue;
+
+        if(idx == 0)
+        {
+            shape[idx] = 1;
+            model->dynamicBatch = true;
+        }else if(idx == 1)
+            shape[idx] = 3;
+        else
+            shape[idx] = kDefaultInputSize;
+    }
+}
+
 bool ModelParser::parseOutput(Ort::Session* session, Model* model)
 {
     Ort::AllocatorWithDefaultOptions allocator;
@@ -49,7 +83,6 @@ bool ModelParser::parseOutput(Ort::Session* session, Model* model)
     {
         auto name = session->GetOutputNameAllocated(idx, allocator);
         model->outputNames.push_back(name.get());
-        model->outputNamesPtr.push_back(model->outputNames.back().c_str());
        
         auto TypeInfo = session->GetOutputTypeInfo(idx);
         auto TypeAndShape = TypeInfo.GetTensorTypeAndShapeInfo();
@@ -57,6 +90,25 @@ bool ModelParser::parseOutput(Ort::Session* session, Model* model)
         model->outputShapes.emplace_back(TypeAndShape.GetShape());
     } 
 
+    // 同 parseInput, 全部名字加入后再取指针
+    for(const auto& name : model->outputNames)
+        model->outputNamesPtr.push_back(name.c_str());
+
+    // 按维度区分输出: 3维为已解码的 [1, N, no], 4/5维为检测头。
+    // --grid 导出同时包含两者, seg 模型还有 4维的 protos, 只要存在已解码输出就优先使用它
+    bool hasDecoded = false;
+    for(size_t idx = 0; idx < model->outputShapes.size(); ++idx)
+    {
+        size_t rank = model->outputShapes[idx].size();
+        if(rank == 3 && !hasDecoded)
+        {
+            model->decodedOutput = idx;
+            hasDecoded = true;
+        }else if(rank == 4 || rank == 5)
+            model->headOutputs.push_back(idx);
+    }
+    model->rawHeads = !hasDecoded && !model->headOutputs.empty();
+
     return true;
 }
 
@@ -86,23 +138,135 @@ std::vector<std::string> ModelParser::parseLabelsRaw(const std::string& rawData)
     return labels;
 }
 
-bool ModelParser::parseLabels(Ort::Session* session, Model* model, const std::string& labelKey)
+bool ModelParser::lookupMetadata(Ort::Session* session, const std::string& key, std::string& value)
 {
-    std::string rawJson;
     Ort::AllocatorWithDefaultOptions allocator;
     Ort::ModelMetadata metaData = session->GetModelMetadata();
     auto keys = metaData.GetCustomMetadataMapKeysAllocated(allocator);
      
-    for(const auto& key: keys)
+    for(const auto& it: keys)
     {
-        if(labelKey == key.get())
+        if(key == it.get())
         {
-            auto labelsRaw = metaData.LookupCustomMetadataMapAllocated(labelKey.c_str(), allocator);
-            rawJson = std::string(labelsRaw.get());
-            model->labels = parseLabelsRaw(rawJson);
-            break;
+            auto raw = metaData.LookupCustomMetadataMapAllocated(key.c_str(), allocator);
+            value = std::string(raw.get());
+            return true;
         }
     }
 
+    return false;
+}
+
+bool ModelParser::parseLabels(Ort::Session* session, Model* model, const std::string& labelKey)
+{
+    std::string rawJson;
+    if(lookupMetadata(session, labelKey, rawJson))
+        model->labels = parseLabelsRaw(rawJson);
+
     return !model->labels.empty();
-}
\ No newline at end of file
+}
+
+std::vector<std::vector<float>> ModelParser::parseNumbersRaw(const std::string& rawData)
+{
+    std::vector<std::vector<float>> groups;
+    std::vector<float> current;
+    std::string number;
+
+    auto flushNumber = [&]() {
+        try
+        {
+            if(!number.empty())
+                current.push_back(std::stof(number));
+        }
+        catch(const std::exception&)
+        {
+            std::cerr << "invalid number in metadata: " << number << "\n";
+        }
+        number.clear();
+    };
+
+    for(char ch : rawData)
+    {
+        if(std::isdigit(static_cast<unsigned char>(ch)) || ch == '.' || ch == '-' || ch == 'e' || ch == '+')
+        {
+            number.push_back(ch);
+            continue;
+        }
+
+        flushNumber();
+        // 只在最内层的括号结束时收集一组, 外层括号不产生空组
+        if(ch == ']' && !current.empty())
+        {
+            groups.push_back(current);
+            current.clear();
+        }
+    }
+    flushNumber();
+    if(!current.empty())
+        groups.push_back(current);
+
+    return groups;
+}
+
+bool ModelParser::parseAnchors(Ort::Session* session, Model* model)
+{
+    // 存在已解码输出时 Detect 层已包含在模型中, 不需要 anchor
+    if(!model->rawHeads)
+        return true;
+
+    const size_t headCnt = model->headOutputs.size();
+    std::string raw;
+
+    if(lookupMetadata(session, "anchors", raw))
+    {
+        auto groups = parseNumbersRaw(raw);
+        // 兼容扁平格式: [10,13, 16,30, ...], 按检测头数平分
+        if(groups.size() == 1 && groups[0].size() % (headCnt * 2) == 0)
+        {
+            size_t perHead = groups[0].size() / headCnt;
+            for(size_t head = 0; head < headCnt; ++head)
+                model->anchors.emplace_back(groups[0].begin() + head * perHead, groups[0].begin() + (head + 1) * perHead);
+        }else
+            model->anchors = groups;
+    }else if(headCnt == kDefaultAnchors.size())
+    {
+        for(const auto& anchor : kDefaultAnchors)
+            model->anchors.emplace_back(anchor.begin(), anchor.end());
+    }
+
+    if(lookupMetadata(session, "strides", raw) || lookupMetadata(session, "stride", raw))
+    {
+        auto groups = parseNumbersRaw(raw);
+        for(const auto& group : groups)
+            model->strides.insert(model->strides.end(), group.begin(), group.end());
+        // yolov5 导出的 stride 只有最大步长一个值, 此时改为按特征图大小计算
+        if(model->strides.size() != headCnt)
+            model->strides.clear();
+    }
+
+    if(model->anchors.size() != headCnt)
+        return false;
+
+    for(size_t head = 0; head < headCnt; ++head)
+    {
+        const auto& anchor = model->anchors[head];
+        if(anchor.empty() || anchor.size() % 2 != 0)
+            return false;
+
+        // 静态维度时检查 anchor 数与检测头的通道数是否一致: 5维 [1, na, ny, nx, no], 4维 [1, na * no, ny, nx]
+        const auto& shape = model->outputShapes[model->headOutputs[head]];
+        const int64_t na = static_cast<int64_t>(anchor.size() / 2);
+        if(shape[1] <= 0)
+            continue;
+
+        bool matched = shape.size() == 5 ? shape[1] == na
+            : shape[1] % na == 0 && shape[1] / na > YOLOV5_OUTBOX_ELEMENT_COUNT;
+        if(!matched)
+        {
+            std::cerr << "anchors of head " << head << " do not match output shape\n";
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <string>
 #include <vector>
 
@@ -25,6 +26,11 @@ private:
 
     static bool parseOutput(Ort::Session* session, Model* model);
 
+    /// @brief 将输入中的动态维度替换为默认大小(batch 为1, 宽高为 kDefaultInputSize)
+    /// @param shape 模型中读取到的输入维度
+    /// @param model 记录 batch 是否为动态
+    static void resolveDynamicShape(std::vector<int64_t>& shape, Model* model);
+
     /// @brief 解析标签，需要保证这个onnx 中存在这个names的这个键值对, 不然会报错
     /// @param session 已加载的ort session 
     /// @param model 需要输出的model*
@@ -34,5 +40,29 @@ private:
     
     static std::vector<std::string> parseLabelsRaw(const std::string& rawData);
 
+    /// @brief 解析未解码检测头需要的 anchors 和 strides, 来自模型元数据中的 anchors / strides 键值对。
+    /// anchors 以像素为单位, 例如 "[[10,13, 16,30, 33,23], [30,61, 62,45, 59,119], [116,90, 156,198, 373,326]]";
+    /// 元数据中没有 anchors 且检测头为3个时使用 yolov5 默认 anchor
+    /// @param session 已加载的ort session
+    /// @param model 需要输出的model*, 需要已经解析完输出
+    /// @return 模型带有已解码的输出, 或者每个检测头都有有效的 anchor 时返回true
+    static bool parseAnchors(Ort::Session* session, Model* model);
+
+    /// @brief 解析嵌套列表中的数字, 每个最内层的 [] 为一组
+    static std::vector<std::vector<float>> parseNumbersRaw(const std::string& rawData);
+
+    /// @brief 读取模型元数据中 key 对应的值
+    /// @return 不存在该键时返回false
+    static bool lookupMetadata(Ort::Session* session, const std::string& key, std::string& value);
+
+    static constexpr int64_t kDefaultInputSize = 640;
+
+    /// yolov5 P3/P4/P5 的默认 anchor(像素)
+    static constexpr std::array<std::array<float, 6>, 3> kDefaultAnchors = {{
+        {10, 13, 16, 30, 33, 23},
+        {30, 61, 62, 45, 59, 119},
+        {116, 90, 156, 198, 373, 326}
+    }};
+
 };
 
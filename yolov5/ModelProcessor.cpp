@@ -1,4 +1,8 @@
 #include "ModelProcessor.h"
+#include "runtime/Tracer.h"
+
+#include <cmath>
+#include <limits>
 
 
 ModelProcessor::ModelProcessor(Model* model)
@@ -15,81 +19,139 @@ ModelProcessor::ModelProcessor(Model* model)
         }
     }
 
-    memInfo_ = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+    // 输入直接使用 blob_, 不经过 onnxruntime 的 arena 分配
+    memInfo_ = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtDeviceAllocator, OrtMemType::OrtMemTypeDefault);
 }
 
 ModelProcessor::~ModelProcessor()
 {   
     if(blob_)
-        delete blob_;
+        delete[] blob_;
 
     blob_  = nullptr;
 }
 
 std::vector<Ort::Value> ModelProcessor::Preprocess(const cv::Mat& image)
 {
+    TraceScope scope("Preprocess");
     std::vector<Ort::Value> result;
-    cv::Mat resizedImage, floatImage;
 
     try
     {
         if(!model_ || model_->inputShapes.empty())
             throw std::runtime_error("model_ is nullptr!");
 
-        auto inputShape = model_->inputShapes;
-        auto inputTensorShape = inputShape[0]; // yolov5只有一个 维度输入
+        auto inputTensorShape = model_->inputShapes[0]; // yolov5只有一个 维度输入
 
-        if(!ConvertToRGB(image, resizedImage))
-            throw std::runtime_error("failed to convert to rgb!");
+        FillBlob(image, blob_);
+        
+        result.push_back(
+                Ort::Value::CreateTensor<float>(memInfo_, 
+                blob_, blobSize_, 
+                inputTensorShape.data(), inputTensorShape.size())
+            );
+        
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+    
+    return result;
+}
 
-        // 归一化为统一大小
-        resizedImage = Letterbox(resizedImage, cv::Size(inputTensorShape.at(2), inputTensorShape.at(3)));
+std::vector<Ort::Value> ModelProcessor::Preprocess(const std::vector<cv::Mat>& images)
+{
+    TraceScope scope("Preprocess");
+    std::vector<Ort::Value> result;
 
-        // 映射 0~255到 0~1之间
-        resizedImage.convertTo(floatImage, CV_32FC3, 1 / 255.0);
+    try
+    {
+        if(!model_ || model_->inputShapes.empty())
+            throw std::runtime_error("model_ is nullptr!");
 
-        cv::Size floatImageSize {floatImage.cols, floatImage.rows};
+        auto inputTensorShape = model_->inputShapes[0];
+        inputTensorShape[0] = static_cast<int64_t>(images.size());
 
-        // hwc -> chw(height width channels)
-        std::vector<cv::Mat> chw(floatImage.channels());
-        for (int i = 0; i < floatImage.channels(); ++i)
-        {
-            chw[i] = cv::Mat(floatImageSize, CV_32FC1, blob_ + i * floatImageSize.width * floatImageSize.height);
-        }
-        cv::split(floatImage, chw);
+        // blobSize_ 对应 batch 为1的输入
+        batchBlob_.resize(blobSize_ * images.size());
+        for(size_t idx = 0; idx < images.size(); ++idx)
+            FillBlob(images[idx], batchBlob_.data() + idx * blobSize_);
 
-        //std::vector<float>inputTensorValues(blob_, blob_ + blobSize_);
-        
         result.push_back(
                 Ort::Value::CreateTensor<float>(memInfo_, 
-                blob_, blobSize_, 
+                batchBlob_.data(), batchBlob_.size(), 
                 inputTensorShape.data(), inputTensorShape.size())
             );
-        
     }
     catch(const std::exception& e)
     {
         std::cerr << e.what() << '\n';
     }
-    
+
     return result;
 }
 
+void ModelProcessor::FillBlob(const cv::Mat& image, float* blob)
+{
+    cv::Mat resizedImage, floatImage;
+    const auto& inputTensorShape = model_->inputShapes[0];
+
+    {
+        TraceScope step("ConvertToRGB");
+        if(!ConvertToRGB(image, resizedImage))
+            throw std::runtime_error("failed to convert to rgb!");
+    }
+
+    // 归一化为统一大小
+    {
+        TraceScope step("Letterbox");
+        resizedImage = Letterbox(resizedImage, cv::Size(inputTensorShape.at(2), inputTensorShape.at(3)));
+    }
+
+    // 映射 0~255到 0~1之间
+    {
+        TraceScope step("Normalize");
+        resizedImage.convertTo(floatImage, CV_32FC3, 1 / 255.0);
+    }
+
+    cv::Size floatImageSize {floatImage.cols, floatImage.rows};
+
+    // hwc -> chw(height width channels)
+    TraceScope step("HWC2CHW");
+    std::vector<cv::Mat> chw(floatImage.channels());
+    for (int i = 0; i < floatImage.channels(); ++i)
+    {
+        chw[i] = cv::Mat(floatImageSize, CV_32FC1, blob + i * floatImageSize.width * floatImageSize.height);
+    }
+    cv::split(floatImage, chw);
+}
+
 std::vector<ResultNode> ModelProcessor::Postprocess(const std::vector<Ort::Value>& outTensor, 
             const cv::Size& originalImageShape, 
-            float confThreshold, float iouThreshold)
+            float confThreshold, float iouThreshold, size_t batchIdx)
 {
+    TraceScope scope("Postprocess");
     std::vector<cv::Rect> boxes;
     std::vector<float> confs;
     std::vector<int> classIds;
     const auto& Shape = model_->inputShapes[0];
     cv::Size resizedImageShape = { static_cast<int>(Shape[3]), static_cast<int>(Shape[2]) };
     
-    ParseRawOutput(outTensor, confThreshold, boxes, confs, classIds);
+    {
+        TraceScope step("ParseRawOutput");
+        if(model_->rawHeads)
+            ParseRawHeads(outTensor, confThreshold, boxes, confs, classIds, batchIdx);
+        else
+            ParseRawOutput(outTensor, confThreshold, boxes, confs, classIds, batchIdx);
+    }
 
     std::vector<int> indices; // store the nms result (index)
     // nms
-    cv::dnn::NMSBoxes(boxes, confs, confThreshold, iouThreshold, indices);
+    {
+        TraceScope step("NMS");
+        cv::dnn::NMSBoxes(boxes, confs, confThreshold, iouThreshold, indices);
+    }
     std::vector<ResultNode> detections;
 
     for (int idx : indices)
@@ -203,7 +265,7 @@ void ModelProcessor::GetOriCoords(const cv::Size& currentShape,
 }
 
 
-void ModelProcessor::GetBestClassInfo(std::vector<float>::iterator it, 
+void ModelProcessor::GetBestClassInfo(const float* it, 
     const int& numClasses, float& bestConf, int& bestClassId)
 {
   // first 5 element are box and obj confidence
@@ -221,21 +283,21 @@ void ModelProcessor::GetBestClassInfo(std::vector<float>::iterator it,
   }
 }
 
-void ModelProcessor::ParseRawOutput(const std::vector<Ort::Value>& tensor, float conf_threshold, std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds)
+void ModelProcessor::ParseRawOutput(const std::vector<Ort::Value>& tensor, float conf_threshold, std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds, size_t batchIdx)
 {
-    auto* rawOutput = tensor.at(0).GetTensorData<float>();
-    std::vector<int64_t> outputShape = tensor.at(0).GetTensorTypeAndShapeInfo().GetShape();
-    size_t count = tensor.at(0).GetTensorTypeAndShapeInfo().GetElementCount();
-    std::vector<float> output(rawOutput, rawOutput + count);
+    const Ort::Value& decoded = tensor.at(model_->decodedOutput);
+    auto* rawOutput = decoded.GetTensorData<float>();
+    std::vector<int64_t> outputShape = decoded.GetTensorTypeAndShapeInfo().GetShape();
 
     int numClasses = (int)outputShape.at(2) - YOLOV5_OUTBOX_ELEMENT_COUNT; // 这个受模型影响
     int elementsInBatch = (int)(outputShape.at(1) * outputShape.at(2));
 
-    // only for batch size = 1
-    for (auto it = output.begin(); it != output.begin() + elementsInBatch; it += outputShape.at(2))
+    // 直接在输出上读取当前 batch 的部分, 批量推理时每张图像都拷贝整个输出的开销与 batch 大小的平方成正比
+    const float* batchBegin = rawOutput + batchIdx * elementsInBatch;
+    for (const float* it = batchBegin; it != batchBegin + elementsInBatch; it += outputShape.at(2))
     {
         
-        const RawResult* box = reinterpret_cast<const RawResult*>(&(*it)); 
+        const RawResult* box = reinterpret_cast<const RawResult*>(it); 
         float clsConf = box->cls_conf;
 
         if (clsConf > conf_threshold)
@@ -258,4 +320,104 @@ void ModelProcessor::ParseRawOutput(const std::vector<Ort::Value>& tensor, float
             classIds.emplace_back(classId);
         }
     }
-}
\ No newline at end of file
+}
+
+void ModelProcessor::ParseRawHeads(const std::vector<Ort::Value>& tensor, float conf_threshold, std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds, size_t batchIdx)
+{
+    // 在 logit 空间比较 objectness, 只对通过阈值的格子做 sigmoid 和解码
+    const float objLogitThreshold = Logit(conf_threshold);
+    const int64_t inputHeight = model_->inputShapes[0][2];
+
+    for(size_t head = 0; head < model_->headOutputs.size() && head < model_->anchors.size(); ++head)
+    {
+        const Ort::Value& output = tensor.at(model_->headOutputs[head]);
+        auto info = output.GetTensorTypeAndShapeInfo();
+        std::vector<int64_t> shape = info.GetShape();
+        const float* data = output.GetTensorData<float>() + batchIdx * (info.GetElementCount() / shape.at(0));
+        const auto& anchors = model_->anchors[head];
+        const int64_t na = static_cast<int64_t>(anchors.size() / 2);
+        int64_t ny, nx, no;
+        int64_t channelStep; // 同一个格子相邻两个通道之间的距离
+
+        // anchor 来自元数据, 与输出维度不一致时跳过该检测头, 避免越界或通道错位
+        if(shape.size() == 5)       // [1, na, ny, nx, no]
+        {
+            if(shape[1] != na)
+                continue;
+            ny = shape[2];
+            nx = shape[3];
+            no = shape[4];
+            channelStep = 1;
+        }else if(shape.size() == 4) // [1, na * no, ny, nx]
+        {
+            if(na <= 0 || shape[1] % na != 0)
+                continue;
+            ny = shape[2];
+            nx = shape[3];
+            no = shape[1] / na;
+            channelStep = ny * nx;
+        }else
+            continue;
+
+        if(no <= YOLOV5_OUTBOX_ELEMENT_COUNT || ny <= 0 || nx <= 0)
+            continue;
+
+        const float stride = head < model_->strides.size() ? model_->strides[head] : static_cast<float>(inputHeight) / ny;
+
+        for(int64_t a = 0; a < na; ++a)
+        {
+            for(int64_t y = 0; y < ny; ++y)
+            {
+                for(int64_t x = 0; x < nx; ++x)
+                {
+                    const float* cell = shape.size() == 5 ? data + ((a * ny + y) * nx + x) * no
+                                                          : data + a * no * ny * nx + y * nx + x;
+
+                    float objLogit = cell[4 * channelStep];
+                    if(objLogit <= objLogitThreshold)
+                        continue;
+
+                    // sigmoid 单调, 直接比较 logit 找最大类别
+                    int classId = 0;
+                    float bestLogit = cell[YOLOV5_OUTBOX_ELEMENT_COUNT * channelStep];
+                    for(int64_t c = 1; c < no - YOLOV5_OUTBOX_ELEMENT_COUNT; ++c)
+                    {
+                        float logit = cell[(YOLOV5_OUTBOX_ELEMENT_COUNT + c) * channelStep];
+                        if(logit > bestLogit)
+                        {
+                            bestLogit = logit;
+                            classId = static_cast<int>(c);
+                        }
+                    }
+
+                    float centerX = (Sigmoid(cell[0]) * 2.f - 0.5f + x) * stride;
+                    float centerY = (Sigmoid(cell[channelStep]) * 2.f - 0.5f + y) * stride;
+                    float w = Sigmoid(cell[2 * channelStep]) * 2.f;
+                    float h = Sigmoid(cell[3 * channelStep]) * 2.f;
+                    int width = static_cast<int>(w * w * anchors[a * 2]);
+                    int height = static_cast<int>(h * h * anchors[a * 2 + 1]);
+                    int left = static_cast<int>(centerX) - width / 2;
+                    int top = static_cast<int>(centerY) - height / 2;
+
+                    boxes.emplace_back(left, top, width, height);
+                    confs.emplace_back(Sigmoid(objLogit) * Sigmoid(bestLogit));
+                    classIds.emplace_back(classId);
+                }
+            }
+        }
+    }
+}
+
+float ModelProcessor::Sigmoid(float x)
+{
+    return 1.f / (1.f + std::exp(-x));
+}
+
+float ModelProcessor::Logit(float p)
+{
+    if(p <= 0.f)
+        return -std::numeric_limits<float>::infinity();
+    if(p >= 1.f)
+        return std::numeric_limits<float>::infinity();
+    return std::log(p / (1.f - p));
+}
@@ -18,20 +18,32 @@ public:
     /// @param image 需要输入的预处理图像
     /// @return 返回可直接输入给Ort的值
     std::vector<Ort::Value> Preprocess(const cv::Mat& image);
+
+    /// @brief 批量预处理, 要求模型的 batch 维度为动态
+    /// @param images 需要输入的预处理图像
+    /// @return 返回 batch 为 images.size() 的输入
+    std::vector<Ort::Value> Preprocess(const std::vector<cv::Mat>& images);
     
     /// @brief yolov5后处理(主要是读取原始onnxruntime生成的数据并解析后经nms处理 的到符合阈值的结果集合并返回)
     /// @param outTensor 推理后输出的tensor
     /// @param originalImageShape 原始图像的shape
     /// @param confThreshold 置信度阈值
     /// @param iouThreshold iou阈值
+    /// @param batchIdx 批量推理时需要解析的 batch 下标
     /// @return 返回处理后的最终数据，包含坐标x,y,w,h, 类别index, 置信度
     std::vector<ResultNode> Postprocess(const std::vector<Ort::Value>& outTensor, 
             const cv::Size& originalImageShape, 
-            float confThreshold, float iouThreshold);
+            float confThreshold, float iouThreshold, size_t batchIdx = 0);
+
+    /// @brief 预处理输入缓冲区占用的字节数
+    size_t InputBufferBytes() const { return (blobSize_ + batchBlob_.capacity()) * sizeof(float); };
 
 private:
     
-
+    /// @brief 转换为RGB、letterbox、归一化后以 CHW 格式写入 blob
+    /// @param image 需要输入的预处理图像
+    /// @param blob 输出位置, 大小为 C * H * W
+    void FillBlob(const cv::Mat& image, float* blob);
     
     /// @brief 将图像归一画为统一大小，主要是符合这个模型的输入维度的尺寸
     /// @param image 输入的图像
@@ -65,7 +77,7 @@ private:
     /// @param numClasses 
     /// @param bestConf 
     /// @param bestClassId 
-    void GetBestClassInfo(std::vector<float>::iterator it, const int& numClasses, float& bestConf, int& bestClassId);
+    void GetBestClassInfo(const float* it, const int& numClasses, float& bestConf, int& bestClassId);
 
     /// @brief 
     /// @param tensor 
@@ -73,7 +85,23 @@ private:
     /// @param boxes 
     /// @param confs 
     /// @param classIds 
-    void ParseRawOutput(const std::vector<Ort::Value>& tensor, float conf_threshold,std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds);
+    /// @param batchIdx 
+    void ParseRawOutput(const std::vector<Ort::Value>& tensor, float conf_threshold,std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds, size_t batchIdx = 0);
+
+    /// @brief 解析未包含 Detect 层的模型输出(P3/P4/P5 三个检测头), 
+    /// 支持 [1, na, ny, nx, no] 和 [1, na * no, ny, nx] 两种布局
+    /// @param tensor 模型的全部输出, 检测头由 Model::headOutputs 指定
+    /// @param conf_threshold objectness 阈值, 在 logit 空间比较
+    /// @param boxes 
+    /// @param confs 
+    /// @param classIds 
+    /// @param batchIdx 
+    void ParseRawHeads(const std::vector<Ort::Value>& tensor, float conf_threshold, std::vector<cv::Rect>& boxes, std::vector<float>& confs, std::vector<int>& classIds, size_t batchIdx = 0);
+
+    static float Sigmoid(float x);
+
+    /// @brief sigmoid 的反函数, 用于把概率阈值转换到 logit 空间
+    static float Logit(float p);
 
 private:
 
@@ -82,5 +110,7 @@ private:
     float* blob_ = nullptr;
     size_t blobSize_ = 0;
 
+    std::vector<float> batchBlob_;
+
     Ort::MemoryInfo memInfo_{nullptr};
 };
\ No newline at end of file
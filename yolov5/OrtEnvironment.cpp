@@ -0,0 +1,180 @@
+#include "OrtEnvironment.h"
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include <pthread.h>
+
+
+namespace
+{
+    std::mutex envMutex;
+    // 有意不释放: 避免静态析构顺序导致 Env 先于仍存活的会话析构
+    Ort::Env* sharedEnv = nullptr;
+    bool globalThreadPool = false;
+    bool sharedCpuArena = false;
+}
+
+Ort::Env& OrtEnvironment::Acquire(const SessionConfig& config)
+{
+    std::lock_guard<std::mutex> lock(envMutex);
+    if(sharedEnv)
+    {
+        if(config.useGlobalThreadPool && !globalThreadPool)
+            std::cerr << "global thread pool requested after the env was created without it, "
+                      << "falling back to per-session thread pools\n";
+        return *sharedEnv;
+    }
+
+    if(config.useGlobalThreadPool)
+    {
+        Ort::ThreadingOptions threadingOpt;
+        threadingOpt.SetGlobalIntraOpNumThreads(config.intraOpNumThreads);
+        threadingOpt.SetGlobalInterOpNumThreads(config.interOpNumThreads);
+        threadingOpt.SetGlobalSpinControl(config.allowSpinning ? 1 : 0);
+
+        auto cpus = ResolveAffinity(config);
+        int threads = config.intraOpNumThreads > 0 ? config.intraOpNumThreads : static_cast<int>(cpus.size());
+        std::string affinity = FormatAffinity(cpus, threads);
+        if(!affinity.empty())
+        {
+            threadingOpt.SetGlobalIntraOpNumThreads(threads);
+            Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(threadingOpt, affinity.c_str()));
+        }
+
+        sharedEnv = new Ort::Env(threadingOpt, OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "yolov5");
+        globalThreadPool = true;
+    }else{
+        sharedEnv = new Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "yolov5");
+    }
+
+    return *sharedEnv;
+}
+
+bool OrtEnvironment::HasGlobalThreadPool()
+{
+    std::lock_guard<std::mutex> lock(envMutex);
+    return globalThreadPool;
+}
+
+bool OrtEnvironment::RegisterSharedCpuArena(const SessionConfig& config)
+{
+    Ort::Env& env = Acquire(config);
+    std::lock_guard<std::mutex> lock(envMutex);
+    if(sharedCpuArena)
+        return true;
+
+    try
+    {
+        int strategy = config.arenaExtendStrategy == ArenaExtendStrategy::SameAsRequested ? 1 : 0;
+        Ort::MemoryInfo memInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+        // -1 表示 initial_chunk_size_bytes / max_dead_bytes_per_chunk 使用默认值
+        Ort::ArenaCfg arenaCfg(config.arenaMaxBytes, strategy, -1, -1);
+        env.CreateAndRegisterAllocator(memInfo, arenaCfg);
+        sharedCpuArena = true;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "failed to register shared cpu arena: " << e.what() << "\n";
+    }
+    return sharedCpuArena;
+}
+
+std::vector<int> OrtEnvironment::ResolveAffinity(const SessionConfig& config)
+{
+    if(!config.cpuAffinity.empty())
+        return config.cpuAffinity;
+
+    if(config.numaNode < 0)
+        return {};
+
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(config.numaNode) + "/cpulist");
+    std::string cpuList;
+    if(!file || !std::getline(file, cpuList))
+    {
+        std::cerr << "failed to read cpulist of numa node " << config.numaNode << "\n";
+        return {};
+    }
+
+    return ParseCpuList(cpuList);
+}
+
+std::string OrtEnvironment::FormatAffinity(const std::vector<int>& cpus, int threads)
+{
+    if(cpus.empty() || threads <= 1)
+        return "";
+
+    // 每个线程绑定一个核, 调用线程默认占用 cpus[0], 线程数多于核数时循环复用
+    std::ostringstream out;
+    for(int idx = 1; idx < threads; ++idx)
+    {
+        if(idx > 1)
+            out << ";";
+        out << cpus[idx % cpus.size()] + 1; // onnxruntime 的逻辑核编号从1开始
+    }
+    return out.str();
+}
+
+std::vector<int> OrtEnvironment::CallerAffinity(const std::vector<int>& cpus, int threads)
+{
+    if(cpus.empty())
+        return {};
+
+    if(threads <= 1)
+        return cpus;
+
+    return {cpus[0]};
+}
+
+std::vector<int> OrtEnvironment::ParseCpuList(const std::string& cpuList)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(cpuList);
+    std::string range;
+
+    while(std::getline(stream, range, ','))
+    {
+        if(range.empty())
+            continue;
+
+        size_t dash = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        catch(const std::exception&)
+        {
+            std::cerr << "invalid cpulist entry: " << range << "\n";
+        }
+    }
+    return cpus;
+}
+
+ScopedThreadAffinity::ScopedThreadAffinity(const std::vector<int>& cpus)
+{
+    if(cpus.empty())
+        return;
+
+    if(pthread_getaffinity_np(pthread_self(), sizeof(previous_), &previous_) != 0)
+        return;
+
+    cpu_set_t target;
+    CPU_ZERO(&target);
+    for(int cpu : cpus)
+    {
+        if(cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &target);
+    }
+    pinned_ = pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0;
+}
+
+ScopedThreadAffinity::~ScopedThreadAffinity()
+{
+    if(pinned_)
+        pthread_setaffinity_np(pthread_self(), sizeof(previous_), &previous_);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+#include <sched.h>
+
+#include "SessionConfig.h"
+
+
+/// @brief 进程级的 Ort::Env 管理, 所有会话共用同一个环境(以及可选的全局线程池)
+class OrtEnvironment
+{
+public:
+    OrtEnvironment() = delete;
+    ~OrtEnvironment() = delete;
+
+    /// @brief 获取进程共享的 Ort::Env, 第一次调用时按 config 创建
+    /// @param config 会话配置, 只有第一次调用时的线程池相关配置生效
+    /// @return 返回共享的环境
+    static Ort::Env& Acquire(const SessionConfig& config);
+
+    /// @brief 共享环境是否带有全局线程池
+    static bool HasGlobalThreadPool();
+
+    /// @brief 在共享环境上注册 CPU arena, 只有第一次调用时的 arena 配置生效
+    /// @param config 会话配置
+    /// @return 返回共享 arena 是否可用
+    static bool RegisterSharedCpuArena(const SessionConfig& config);
+
+    /// @brief 根据配置得到需要绑定的逻辑核列表(cpuAffinity 优先, 其次 numaNode)
+    /// @param config 会话配置
+    /// @return 返回逻辑核编号, 为空表示不绑定
+    static std::vector<int> ResolveAffinity(const SessionConfig& config);
+
+    /// @brief 生成 onnxruntime 的线程亲和性字符串, 例如 "1;2;3"
+    /// 第0个线程是调用 Run 的线程, 不由 onnxruntime 管理, 所以只需要 threads - 1 项,
+    /// 调用线程需要另外通过 ScopedThreadAffinity 绑定到 CallerAffinity 返回的核
+    /// @param cpus 可用的逻辑核
+    /// @param threads 线程池的线程数
+    /// @return 返回亲和性字符串, 无需绑定时返回空串
+    static std::string FormatAffinity(const std::vector<int>& cpus, int threads);
+
+    /// @brief 调用 Run 的线程需要绑定的逻辑核
+    /// @param cpus 可用的逻辑核
+    /// @param threads 线程池的线程数
+    /// @return 单线程时为全部 cpus(没有池线程, 全部计算都在调用线程上), 否则为 cpus[0]
+    static std::vector<int> CallerAffinity(const std::vector<int>& cpus, int threads);
+
+    /// @brief 解析 linux cpulist 格式, 例如 "0-3,8,10-11"
+    static std::vector<int> ParseCpuList(const std::string& cpuList);
+};
+
+
+/// @brief 在作用域内把当前线程绑定到指定的逻辑核, 析构时恢复原来的亲和性
+class ScopedThreadAffinity
+{
+public:
+    /// @param cpus 需要绑定的逻辑核, 为空时不做任何操作
+    explicit ScopedThreadAffinity(const std::vector<int>& cpus);
+    ~ScopedThreadAffinity();
+
+    ScopedThreadAffinity(const ScopedThreadAffinity&) = delete;
+    ScopedThreadAffinity& operator=(const ScopedThreadAffinity&) = delete;
+
+private:
+    bool pinned_ = false;
+    cpu_set_t previous_;
+};
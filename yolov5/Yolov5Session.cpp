@@ -1,7 +1,19 @@
 #include "Yolov5Session.h"
+#include "OrtEnvironment.h"
+#include "runtime/Tracer.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
 
-Yolov5Session::Yolov5Session()
+#include <malloc.h>
+
+#include "runtime/MemoryStats.h"
+
+
+Yolov5Session::Yolov5Session(const SessionConfig& config)
+    :config_(config)
 {
 
 }
@@ -9,6 +21,8 @@ Yolov5Session::Yolov5Session()
 
 Yolov5Session::~Yolov5Session()
 {
+    JoinInitialization();
+
     if(processor_)
         delete processor_;
     
@@ -21,21 +35,99 @@ Yolov5Session::~Yolov5Session()
 
 bool Yolov5Session::Initialize(const std::string& modelPath)
 {
-    
-    return CreateSession(modelPath) && ParseModel() && WarmUpModel();
+    bool valid = false;
+    SetState(SessionState::Loading);
+
+    try
+    {
+        size_t rssBefore = CurrentRssBytes();
+        valid = CreateSession(modelPath) && ParseModel();
+        size_t rssAfter = CurrentRssBytes();
+        loadRssDeltaBytes_.store(rssAfter > rssBefore ? rssAfter - rssBefore : 0);
+
+        valid = valid && WarmUpModel();
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+
+    SetState(valid ? SessionState::Ready : SessionState::Failed);
+    return valid;
 }
 
 std::vector<ResultNode> Yolov5Session::Detect(const cv::Mat& image)
+{
+    if(GetState() != SessionState::Ready)
+        return {};
+
+    if(config_.enableTracing)
+        Tracer::Instance().BeginFrame();
+
+    TraceScope scope("Detect");
+    return Infer(image);
+}
+
+std::vector<std::vector<ResultNode>> Yolov5Session::DetectBatch(const std::vector<cv::Mat>& images)
+{
+    if(GetState() != SessionState::Ready)
+        return std::vector<std::vector<ResultNode>>(images.size());
+
+    if(!model_->dynamicBatch || images.size() <= 1)
+        return ISession::DetectBatch(images);
+
+    if(config_.enableTracing)
+        Tracer::Instance().BeginFrame();
+
+    TraceScope scope("DetectBatch");
+    std::vector<std::vector<ResultNode>> results;
+
+    auto inputTensor = processor_->Preprocess(images);
+    if(inputTensor.empty())
+        return std::vector<std::vector<ResultNode>>(images.size());
+
+    std::vector<Ort::Value> outTensor = Run(inputTensor);
+
+    for(size_t idx = 0; idx < images.size(); ++idx)
+        results.push_back(processor_->Postprocess(outTensor, images[idx].size(), confidenceThreshold_, iouThreshold_, idx));
+
+    return results;
+}
+
+size_t Yolov5Session::MaxBatch()
+{
+    if(GetState() != SessionState::Ready || !model_->dynamicBatch)
+        return 1;
+    return std::numeric_limits<size_t>::max();
+}
+
+bool Yolov5Session::WriteTrace(const std::string& path)
+{
+    if(!config_.enableTracing)
+        return false;
+
+    // onnxruntime 的 profiling 只能结束一次, 之后再调用 EndProfiling 会返回空路径
+    if(config_.traceOrtProfiling && session_ && !ortProfilingEnded_)
+    {
+        ortProfilingEnded_ = true;
+        Ort::AllocatorWithDefaultOptions allocator;
+        int64_t startNs = static_cast<int64_t>(session_.GetProfilingStartTimeNs());
+        auto profilePath = session_.EndProfilingAllocated(allocator);
+        Tracer::Instance().AddOrtProfile(profilePath.get(), startNs);
+    }
+
+    return Tracer::Instance().WriteChromeTrace(path);
+}
+
+std::vector<ResultNode> Yolov5Session::Infer(const cv::Mat& image)
 {
     std::vector<ResultNode> result;
-    const auto& inputNames = model_->inputNamesPtr;
-    const auto& outputNames = model_->outputNamesPtr;
     
     if(processor_)
     {
         auto inputTensor = processor_->Preprocess(image);
 
-        std::vector<Ort::Value>outTensor = session_.Run(Ort::RunOptions{nullptr}, inputNames.data(), inputTensor.data(), inputTensor.size(), outputNames.data(), outputNames.size());
+        std::vector<Ort::Value> outTensor = Run(inputTensor);
         
         result = processor_->Postprocess(outTensor, image.size(), confidenceThreshold_, iouThreshold_);
     }
@@ -43,30 +135,193 @@ std::vector<ResultNode> Yolov5Session::Detect(const cv::Mat& image)
     return result;
 }
 
+std::vector<Ort::Value> Yolov5Session::Run(std::vector<Ort::Value>& inputTensor)
+{
+    TraceScope scope("Run");
+    const auto& inputNames = model_->inputNamesPtr;
+    const auto& outputNames = model_->outputNamesPtr;
+
+    bool shrink = config_.shrinkArenaAfterRun || shrinkPending_.exchange(false);
+    Ort::RunOptions runOptions{nullptr};
+    if(shrink && config_.enableCpuMemArena)
+    {
+        runOptions = Ort::RunOptions();
+        runOptions.AddConfigEntry("memory.enable_memory_arena_shrinkage", "cpu:0");
+    }
+
+    // 调用线程也承担一份 intra-op 计算, 推理期间绑定到会话的核上
+    ScopedThreadAffinity affinity(callerCpus_);
+    auto outTensor = session_.Run(runOptions, inputNames.data(), inputTensor.data(), inputTensor.size(), outputNames.data(), outputNames.size());
+
+    return outTensor;
+}
+
+SessionMemoryStats Yolov5Session::GetMemoryStats()
+{
+    SessionMemoryStats stats;
+    stats.loadRssDeltaBytes = loadRssDeltaBytes_.load();
+    stats.inputBufferBytes = processor_ ? processor_->InputBufferBytes() : 0;
+    stats.arenaStatsAvailable = GetState() == SessionState::Ready && ReadArenaStats(stats);
+    stats.sharedArena = stats.arenaStatsAvailable && config_.useSharedCpuArena;
+    stats.currentBytes = stats.arenaInUseBytes + stats.inputBufferBytes;
+    stats.peakBytes = stats.arenaPeakBytes + stats.inputBufferBytes;
+    stats.processRssBytes = CurrentRssBytes();
+    stats.processPeakRssBytes = PeakRssBytes();
+    return stats;
+}
+
+bool Yolov5Session::ReadArenaStats(SessionMemoryStats& stats)
+{
+#if ORT_API_VERSION >= 23
+    if(!config_.enableCpuMemArena)
+        return false;
+
+    try
+    {
+        // 按内存位置向会话取分配器, 得到的是本会话使用的 CPU arena(共享 arena 时为 Env 上的那一个)
+        Ort::MemoryInfo memInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+        Ort::Allocator allocator(session_, memInfo);
+
+        const OrtApi& api = Ort::GetApi();
+        OrtKeyValuePairs* pairs = nullptr;
+        Ort::ThrowOnError(api.AllocatorGetStats(allocator, &pairs));
+
+        const char* const* keys = nullptr;
+        const char* const* values = nullptr;
+        size_t count = 0;
+        api.GetKeyValuePairs(pairs, &keys, &values, &count);
+        for(size_t idx = 0; idx < count; ++idx)
+        {
+            std::string key = keys[idx];
+            size_t value = static_cast<size_t>(std::strtoull(values[idx], nullptr, 10));
+            if(key == "InUse")
+                stats.arenaInUseBytes = value;
+            else if(key == "MaxInUse")
+                stats.arenaPeakBytes = value;
+            else if(key == "TotalAllocated")
+                stats.arenaReservedBytes = value;
+        }
+        api.ReleaseKeyValuePairs(pairs);
+        return count > 0;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "failed to read arena stats: " << e.what() << "\n";
+    }
+#else
+    (void)stats;
+#endif
+    return false;
+}
+
+bool Yolov5Session::ShrinkArena()
+{
+    if(GetState() != SessionState::Ready)
+        return false;
+
+    // onnxruntime 只在 Run 结束时收缩 arena, 用一次空白输入的推理触发
+    if(config_.enableCpuMemArena)
+    {
+        const auto& inputShape = model_->inputShapes.at(0);
+        cv::Mat image(static_cast<int>(inputShape.at(2)), static_cast<int>(inputShape.at(3)), 
+            CV_8UC3, cv::Scalar(114, 114, 114));
+        shrinkPending_.store(true);
+        Infer(image);
+    }
+
+    // 同时把 malloc 中空闲的内存归还系统
+    malloc_trim(0);
+    return true;
+}
+
 bool Yolov5Session::CreateSession(const std::filesystem::path& modelPath)
 {
     if(!std::filesystem::exists(modelPath))
         return false;
 
     envName_ = modelPath.filename().string();
-    env_ = Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, envName_.c_str());
+    Ort::Env& env = OrtEnvironment::Acquire(config_);
     
     sessionOpt = Ort::SessionOptions();
-    sessionOpt.SetIntraOpNumThreads(0);
+    sessionOpt.SetLogId(envName_.c_str());
     sessionOpt.SetGraphOptimizationLevel(ORT_ENABLE_BASIC);
+    ApplyThreadingOptions();
+    ApplyMemoryOptions();
+
+    if(config_.enableTracing)
+    {
+        Tracer::Instance().Enable(static_cast<uint32_t>(std::max(1, config_.traceSampleEvery)));
+        if(config_.traceOrtProfiling)
+            sessionOpt.EnableProfiling((config_.ortProfilePrefix + "_" + envName_).c_str());
+    }
 
-    if(useGpu && IsGPUAvailable())
+    if(config_.useGpu && IsGPUAvailable())
     {
         auto cudaOptions = CreateCudaOptions();
         sessionOpt.AppendExecutionProvider_CUDA(cudaOptions);
     }
 
-    session_ = Ort::Session(env_, modelPath.c_str(), sessionOpt);
+    session_ = Ort::Session(env, modelPath.c_str(), sessionOpt);
+    ortProfilingEnded_ = false;
     return true;
 }
 
+void Yolov5Session::ApplyMemoryOptions()
+{
+    if(config_.enableMemPattern)
+        sessionOpt.EnableMemPattern();
+    else
+        sessionOpt.DisableMemPattern();
+
+    if(!config_.enableCpuMemArena)
+    {
+        sessionOpt.DisableCpuMemArena();
+        return;
+    }
+
+    sessionOpt.EnableCpuMemArena();
+    if(config_.useSharedCpuArena && OrtEnvironment::RegisterSharedCpuArena(config_))
+        sessionOpt.AddConfigEntry("session.use_env_allocators", "1");
+}
+
+void Yolov5Session::ApplyThreadingOptions()
+{
+    sessionOpt.SetExecutionMode(config_.executionMode == SessionExecutionMode::Parallel ? 
+        ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+    callerCpus_.clear();
+
+    // 使用全局线程池时, 线程数、自旋和亲和性都由创建 Env 时的全局配置决定
+    if(config_.useGlobalThreadPool && OrtEnvironment::HasGlobalThreadPool())
+    {
+        sessionOpt.DisablePerSessionThreads();
+        return;
+    }
+
+    auto cpus = OrtEnvironment::ResolveAffinity(config_);
+    int intraThreads = config_.intraOpNumThreads;
+    if(intraThreads <= 0 && !cpus.empty())
+        intraThreads = static_cast<int>(cpus.size());
+
+    sessionOpt.SetIntraOpNumThreads(intraThreads);
+    sessionOpt.SetInterOpNumThreads(config_.interOpNumThreads);
+
+    const char* spinning = config_.allowSpinning ? "1" : "0";
+    sessionOpt.AddConfigEntry("session.intra_op.allow_spinning", spinning);
+    sessionOpt.AddConfigEntry("session.inter_op.allow_spinning", spinning);
+
+    std::string affinity = OrtEnvironment::FormatAffinity(cpus, intraThreads);
+    if(!affinity.empty())
+        sessionOpt.AddConfigEntry("session.intra_op_thread_affinities", affinity.c_str());
+    callerCpus_ = OrtEnvironment::CallerAffinity(cpus, intraThreads);
+}
+
 bool Yolov5Session::ParseModel()
 {
+    // 重复初始化时释放上一次解析的结果
+    delete processor_;
+    delete model_;
+    processor_ = nullptr;
+
     model_ = ModelParser::parse(&session_);
     if(!model_)
         return false;
@@ -97,37 +352,40 @@ bool Yolov5Session::IsGPUAvailable()
     return cudaAvailable != availableProviders.end();
 }
 
-template<class T>
-static size_t MultiVec(const std::vector<T>& data)
-{
-    size_t total = 1;
-    for(const auto& it : data)
-        total *= it;
-    
-    return total;
-}
-
 bool Yolov5Session::WarmUpModel()
 {
-    if(!warmup) 
+    if(!config_.warmup) 
         return true;
 
-    Ort::MemoryInfo memInfo = Ort::MemoryInfo::CreateCpu(OrtAllocatorType::OrtArenaAllocator, OrtMemTypeDefault);
-    const auto& inputName = model_->inputNamesPtr;
-    const auto& outputName = model_->outputNamesPtr;
-    const auto& inputShape =  model_->inputShapes;
-    size_t inputSize = MultiVec(inputShape.at(0));
-
-    std::vector<float> input_data(inputSize);
+    // 按模型实际的输入尺寸走完整的 预处理 -> 推理 -> 后处理, 直到相邻两次延迟接近
+    const auto& inputShape = model_->inputShapes.at(0);
+    cv::Mat image(static_cast<int>(inputShape.at(2)), static_cast<int>(inputShape.at(3)), 
+        CV_8UC3, cv::Scalar(114, 114, 114));
+    int maxIterations = std::max(config_.warmupMinIterations, config_.warmupMaxIterations);
 
+    WarmUpReport report;
+    double lastMs = 0;
+    for(int iter = 0; iter < maxIterations; ++iter)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Infer(image);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    std::vector<Ort::Value> fetches;
-    fetches.push_back(
-        Ort::Value::CreateTensor<float>(memInfo, input_data.data(), input_data.size(), inputShape[0].data(), inputShape[0].size())
-    );
+        report.iterations = iter + 1;
+        if(iter == 0)
+            report.coldLatencyMs = ms;
+        else
+            report.warmLatencyMs = ms;
 
-    
-    session_.Run(Ort::RunOptions{nullptr}, inputName.data(), fetches.data(), fetches.size(), outputName.data(), outputName.size());
+        bool stable = iter > 0 && std::abs(ms - lastMs) <= lastMs * config_.warmupStableRatio;
+        lastMs = ms;
+        if(stable && report.iterations >= config_.warmupMinIterations)
+        {
+            report.stable = true;
+            break;
+        }
+    }
 
+    warmUpReport_ = report;
     return true;
-}
\ No newline at end of file
+}
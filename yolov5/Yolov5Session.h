@@ -1,19 +1,38 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include <filesystem>
 #include <onnxruntime_cxx_api.h>
 #include <opencv2/opencv.hpp>
 
 #include "YoloDefine.h"
+#include "SessionConfig.h"
 
 #include "ModelProcessor.h"
 #include "ModelParser.h"
 #include "ISession.h"
 
+/// @brief 单个会话的内存占用。arena 相关的值来自本会话 CPU arena 自己的统计(需要 onnxruntime 1.23 及以上且开启 arena),
+/// 不受其他会话影响; 开启 useSharedCpuArena 时统计的是所有会话共用的 arena
+struct SessionMemoryStats
+{
+    bool arenaStatsAvailable = false;   // 是否取得了 arena 统计, 为false时 arena 相关的值为0
+    bool sharedArena = false;           // arena 统计来自共享 arena, 不是本会话独占
+    size_t arenaInUseBytes = 0;         // arena 中正在使用的内存
+    size_t arenaPeakBytes = 0;          // arena 中正在使用的内存的历史最大值
+    size_t arenaReservedBytes = 0;      // arena 向系统申请的内存, 包含空闲块
+    size_t inputBufferBytes = 0;        // 预处理使用的输入缓冲区
+    size_t currentBytes = 0;            // arenaInUseBytes + inputBufferBytes
+    size_t peakBytes = 0;               // arenaPeakBytes + inputBufferBytes
+    size_t loadRssDeltaBytes = 0;       // 创建会话和解析模型前后进程 RSS 的增量, 只是估计, 同时加载多个会话时会相互影响
+    size_t processRssBytes = 0;         // 整个进程当前的 RSS
+    size_t processPeakRssBytes = 0;     // 整个进程的 RSS 峰值
+};
+
 class Yolov5Session: public ISession
 {
 public:
-    Yolov5Session();
+    Yolov5Session(const SessionConfig& config = SessionConfig());
     ~Yolov5Session();
 
 
@@ -21,28 +40,71 @@ public:
 
     std::vector<ResultNode> Detect(const cv::Mat& image) override;
 
+    /// @brief 模型的 batch 维度为动态时一次推理全部图像, 否则逐张推理
+    std::vector<std::vector<ResultNode>> DetectBatch(const std::vector<cv::Mat>& images) override;
+
+    /// @brief batch 维度为动态时不限制, 否则为1
+    size_t MaxBatch() override;
+
+    /// @brief 结束 onnxruntime profiling 并把它和流水线耗时合并写出为 Chrome trace / Perfetto JSON。
+    /// 可以多次调用, onnxruntime profiling 只在第一次调用时结束, 之后只更新流水线部分
+    /// @param path 输出路径
+    /// @return 未开启 tracing 或写入失败时返回false
+    bool WriteTrace(const std::string& path);
+
+    /// @brief 获取本会话的内存占用
+    SessionMemoryStats GetMemoryStats();
+
+    /// @brief 收缩 arena 并把 malloc 空闲内存归还系统, 用于突发负载结束后的空闲会话。
+    /// onnxruntime 只在推理结束时收缩 arena, 因此会执行一次空白输入的推理, 不要与 Detect 并发调用
+    /// @return 会话未就绪时返回false
+    bool ShrinkArena();
+
 private:
     bool CreateSession(const std::filesystem::path& modelPath);
 
     bool ParseModel();
 
+    /// @brief 不检查就绪状态的推理, 供 Detect 和预热使用
+    std::vector<ResultNode> Infer(const cv::Mat& image);
+
+    /// @brief 执行 session_.Run, 按配置收缩 arena
+    std::vector<Ort::Value> Run(std::vector<Ort::Value>& inputTensor);
+
     OrtCUDAProviderOptions CreateCudaOptions();
 
     bool IsGPUAvailable();
 
+    /// @brief 按 config_ 设置线程数、执行模式、自旋策略和CPU亲和性
+    void ApplyThreadingOptions();
+
+    /// @brief 按 config_ 设置 CPU arena 和 memory pattern
+    void ApplyMemoryOptions();
+
+    /// @brief 读取本会话 CPU arena 的统计(InUse / MaxInUse / TotalAllocated)
+    /// @return onnxruntime 版本不支持、未开启 arena 或读取失败时返回false
+    bool ReadArenaStats(SessionMemoryStats& stats);
+
 protected:
-    bool WarmUpModel() override; // 暂时有问题
+    /// @brief 以模型实际输入尺寸多次推理直到延迟稳定, 结果记录在 warmUpReport_
+    bool WarmUpModel() override;
 
 private:
 
 
     Ort::Session session_{nullptr};
     Ort::SessionOptions sessionOpt {nullptr};
-    Ort::Env env_{nullptr};
     std::string envName_;
 
     ModelProcessor *processor_ = nullptr;
-    
-    bool useGpu = true;
-    bool warmup = true;
+
+    SessionConfig config_;
+
+    /// 推理期间调用线程绑定的逻辑核, 为空时不绑定
+    std::vector<int> callerCpus_;
+
+    bool ortProfilingEnded_ = false;
+
+    std::atomic<bool> shrinkPending_{false};
+    std::atomic<size_t> loadRssDeltaBytes_{0};
 };
\ No newline at end of file